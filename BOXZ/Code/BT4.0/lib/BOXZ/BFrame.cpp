@@ -0,0 +1,127 @@
+/*
+BFrame.cpp - Binary frames with CRC for the BOXZ app link.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+ */
+
+/*Define
+
+ - Resync
+ Received bytes are kept in _raw until they form a frame. Bytes before a sync byte
+ are dropped. If the length is too long or the CRC is wrong, only the sync byte is
+ dropped and the rest is scanned again, so a good frame that follows a broken one
+ is still found.
+ */
+#include "BFrame.h"
+#include <util/crc16.h>
+
+#define FRAME_BYTES(len)	((len) + 5)
+
+static uint8_t frameCRC(const uint8_t *bytes, uint8_t count)
+{
+  uint8_t crc = 0;
+  while(count--) crc = _crc8_ccitt_update(crc, *bytes++);
+  return crc;
+}
+
+BFrame::BFrame()
+{
+  _errors = 0;
+  _lost = 0;
+  reset();
+}
+
+void BFrame::reset()
+{
+  _head = 0;
+  _ready = false;
+  _synced = false;
+}
+
+void BFrame::drop(uint8_t bytes)
+{
+  _head -= bytes;
+  memmove(_raw, _raw + bytes, _head);
+}
+
+//find a frame in _raw
+int BFrame::scan()
+{
+  for(;;){
+    uint8_t skip = 0;
+    while(skip < _head && _raw[skip] != BFRAME_SYNC) skip++;
+    drop(skip);
+    if(_head < 2) return BFRAME_MORE;
+    uint8_t len = _raw[1];
+    if(len <= BFRAME_PAYLOAD){
+      if(_head < FRAME_BYTES(len)) return BFRAME_MORE;
+      if(frameCRC(_raw + 1, len + 3) == _raw[FRAME_BYTES(len) - 1]) break;
+    }
+    _errors++;
+    drop(1); //look for the next sync byte
+  }
+  if(_synced && _raw[3] != (uint8_t) (_seq + 1)) _lost += (uint8_t) (_raw[3] - _seq - 1);
+  _seq = _raw[3];
+  _synced = true;
+  _ready = true;
+  return BFRAME_READY;
+}
+
+int BFrame::collect(Stream *stream)
+{
+  if(_ready){
+    drop(FRAME_BYTES(_raw[1])); //done with it, keep what came after it
+    _ready = false;
+  }
+  for(;;){
+    if(scan() == BFRAME_READY) return BFRAME_READY;
+    int ch = stream->read();
+    if(ch < 0) return BFRAME_MORE;
+    _raw[_head++] = ch; //scan() left room for the rest of the frame
+  }
+}
+
+uint8_t BFrame::type()
+{
+  return _ready ? _raw[2] : 0;
+}
+
+uint8_t BFrame::seq()
+{
+  return _seq;
+}
+
+const uint8_t* BFrame::payload()
+{
+  return _raw + 4;
+}
+
+uint8_t BFrame::length()
+{
+  return _ready ? _raw[1] : 0;
+}
+
+unsigned int BFrame::errors()
+{
+  return _errors;
+}
+
+unsigned int BFrame::lost()
+{
+  return _lost;
+}
+
+size_t BFrame::send(Print *out, uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+  if(len > BFRAME_PAYLOAD) return 0;
+  uint8_t frame[BFRAME_SIZE];
+  frame[0] = BFRAME_SYNC;
+  frame[1] = len;
+  frame[2] = type;
+  frame[3] = seq;
+  memcpy(frame + 4, payload, len);
+  frame[FRAME_BYTES(len) - 1] = frameCRC(frame + 1, len + 3);
+  return out->write(frame, FRAME_BYTES(len));
+}
@@ -0,0 +1,78 @@
+/*
+BFrame.h - Binary frames with CRC for the BOXZ app link.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ A frame is |sync|len|type|seq|payload(len bytes)|crc|, CRC-8 (polynomial 0x07)
+ over len, type, seq and payload. The longest frame fits into one BLE packet.
+ A bad frame is dropped and the decoder goes on at the next sync byte in it,
+ so the frames after it are not lost.
+
+ The link starts with JSON; the app switches to frames with ME code 5, see
+ processME() of the examples. Old apps never send it and keep using JSON.
+
+ The methods are:
+
+ collect()    - Read the available bytes, returns BFRAME_READY with a complete frame.
+ type()       - Type of the complete frame, one of the frame types below.
+ seq()        - Sequence number of the complete frame.
+ payload()    - Payload of the complete frame.
+ length()     - Payload bytes of the complete frame.
+ errors()     - Frames dropped for a bad CRC or length.
+ lost()       - Frames missing in the sequence numbers.
+ reset()      - Drop all bytes received.
+ send()       - Write one frame in a single write().
+ */
+
+#ifndef __BFRAME_H__
+#define __BFRAME_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define BFRAME_SYNC			0xB5
+#define BFRAME_PAYLOAD		15	// longest payload, the frame is 20 bytes then
+#define BFRAME_SIZE			(BFRAME_PAYLOAD + 5)
+
+//frame types
+#define BFRAME_COMMAND		'C'	// app to BOXZ, CF and AT fields, see BoxzCommand::parseBinary()
+#define BFRAME_REPORT		'P'	// BOXZ to app, PT fields: |id|value low|value high| for each field sent
+#define BFRAME_PROFILE		'F'	// BOXZ to app, BProfile::snapshot() of one stage
+#define BFRAME_ECHO			'E'	// BOXZ to app, answer of a round trip probe: |tag|rx|motor|tx|, micros() 32 bit
+
+//results of collect()
+#define BFRAME_MORE			0
+#define BFRAME_READY		1
+
+class BFrame
+{
+public:
+  BFrame();
+  int collect(Stream *stream);
+  uint8_t type();
+  uint8_t seq();
+  const uint8_t* payload();
+  uint8_t length();
+  unsigned int errors();
+  unsigned int lost();
+  void reset();
+  static size_t send(Print *out, uint8_t type, uint8_t seq, const uint8_t *payload, uint8_t len);
+
+private:
+  uint8_t _raw[BFRAME_SIZE]; //bytes received, a frame starts at _raw[0]
+  uint8_t _head; //bytes in _raw
+  boolean _ready; //_raw holds a complete frame
+  uint8_t _seq; //sequence number of the last frame
+  boolean _synced; //_seq is valid
+  unsigned int _errors;
+  unsigned int _lost;
+  int scan();
+  void drop(uint8_t bytes);
+};
+
+#endif
@@ -251,41 +251,235 @@ void BOXZ::motorRaws(String datas)
 void BOXZ::initServo(){
   int pin01 = SERVO_PIN01;
   int pin02 = SERVO_PIN02;
-  servo01.attach(pin01);  
-  servo02.attach(pin02);  
-  _servoPos01 = SERVO_POS01;
-  _servoPos02 = SERVO_POS02;
-  _servoPosMin = SERVO_POSMIN;
-  _servoPosMax = SERVO_POSMAX;
-  _servoDelay = SERVO_DELAY;
-  servo01.write(_servoPos01); 
-  servo02.write(_servoPos02); 
+  int posMin = SERVO_POSMIN;
+  int posMax = SERVO_POSMAX;
+  initServo(pin01, pin02, posMin, posMax);
 }
 
 // initialization servo with pin define
 void BOXZ::initServo(int pin01,int pin02){
-  servo01.attach(pin01); 
-  servo02.attach(pin02); 
-  _servoPos01 = SERVO_POS01;
-  _servoPos02 = SERVO_POS02;
-  _servoPosMin = SERVO_POSMIN;
-  _servoPosMax = SERVO_POSMAX;
-  _servoDelay = SERVO_DELAY;
-  servo01.write(_servoPos01); 
-  servo02.write(_servoPos02); 
+  int posMin = SERVO_POSMIN;
+  int posMax = SERVO_POSMAX;
+  initServo(pin01, pin02, posMin, posMax);
 }
 
 // initialization servo with pin define and range limit
 void BOXZ::initServo(int pin01,int pin02, int posMin, int posMax){
-  servo01.attach(pin01);
-  servo02.attach(pin02);
+  _servoPin[0] = pin01;
+  _servoPin[1] = pin02;
+  _servoPCA = false;
+  _servoCount = 2;
+  servoBegin(posMin, posMax);
+}
+
+#if BOXZ_PCA9685
+// initialization servo on PCA9685 with default address
+boolean BOXZ::initServoPCA(){
+  return initServoPCA(PCA9685_ADDR);
+}
+
+// initialization servo on PCA9685, all pulses are generated by PCA9685
+boolean BOXZ::initServoPCA(uint8_t addr){
+  boolean ok = pca.begin(addr, PCA9685_FREQ);
+  _servoPCA = true;
+  _servoCount = SERVO_NUM;
+  int posMin = SERVO_POSMIN;
+  int posMax = SERVO_POSMAX;
+  servoBegin(posMin, posMax);
+  return ok;
+}
+
+void BOXZ::pwmWrite(int channel, int value){
+  if(!_servoPCA || channel < SERVO_NUM || channel >= PCA9685_CHANNELS) return;
+  pca.setPWM(channel, value);
+}
+#endif
+
+void BOXZ::servoBegin(int posMin, int posMax){
+  _servoIdle = SERVO_IDLE;
+  _servoStart = millis();
+  _servoOn = 0;
+  for(int id = 1; id <= _servoCount; id++){
+    _servoOnTime[id-1] = 0;
+    servoLoadCal(id);
+    servoAttach(id);
+  }
   _servoPos01 = SERVO_POS01;
   _servoPos02 = SERVO_POS02;
   _servoPosMin = posMin;
   _servoPosMax = posMax;
   _servoDelay = SERVO_DELAY;
-  servo01.write(_servoPos01); 
-  servo02.write(_servoPos02); 
+  servoWrite(1, _servoPos01); 
+  servoWrite(2, _servoPos02); 
+  servoWait();
+}
+
+/****************************calibration function for Servo*********************************/
+/*
+ Each servo has a calibration record in EEPROM at SERVO_CAL_ADDR(servo 1 first).
+ It is loaded once by initServo() into _servoUs0 and _servoScale, then
+ pulse(us) = _servoUs0 + degree * _servoScale / 16
+ is the only degree to pulse conversion, used by all servo functions.
+ Without a valid record the default is 600us(0 degree) to 2400us(180 degree).
+ Servo::attach() keeps its limits as (544 - min)/4 and (2400 - max)/4 in int8_t,
+ so the pulses of 0 and 180 degree(trim included) must be within
+ SERVO_US_LOW..SERVO_US_LOW_MAX and SERVO_US_HIGH_MIN..SERVO_US_HIGH.
+ */
+void BOXZ::servoLoadCal(int id){
+  servoCal_t cal;
+  eeprom_read_block(&cal, (const void*)(SERVO_CAL_ADDR + (id-1)*sizeof(servoCal_t)), sizeof(servoCal_t));
+  if(cal.magic != SERVO_CAL_MAGIC || !servoSetCal(id, cal)){
+    cal.usMin = SERVO_US_MIN;
+    cal.usMax = SERVO_US_MAX;
+    cal.trim = 0;
+    cal.invert = 0;
+    servoSetCal(id, cal);
+  }
+}
+
+//takes the record into _servoUs0 and _servoScale, false if the pulses are out of range
+boolean BOXZ::servoSetCal(int id, const servoCal_t &cal){
+  if(cal.usMin >= cal.usMax || cal.usMax - cal.usMin > 2040) return false;
+  //fixed point scale, range up to 2040us keeps degree * scale in 16 bit
+  int scale = ((cal.usMax - cal.usMin)*16 + 90)/180;
+  if(cal.invert){
+    _servoUs0[id-1] = cal.usMax + cal.trim;
+    _servoScale[id-1] = -scale;
+  }
+  else{
+    _servoUs0[id-1] = cal.usMin + cal.trim;
+    _servoScale[id-1] = scale;
+  }
+  //the limits servoAttach() gives to Servo::attach()
+  int us0 = servoUs(id, 0);
+  int us180 = servoUs(id, 180);
+  int usLow = min(us0, us180);
+  int usHigh = max(us0, us180);
+  return usLow >= SERVO_US_LOW && usLow <= SERVO_US_LOW_MAX &&
+    usHigh >= SERVO_US_HIGH_MIN && usHigh <= SERVO_US_HIGH;
+}
+
+boolean BOXZ::servoCalibrate(int id, int usMin, int usMax, int trim, boolean invert){
+  if(id < 1 || id > _servoCount) return false;
+  servoCal_t cal;
+  cal.magic = SERVO_CAL_MAGIC;
+  cal.usMin = usMin;
+  cal.usMax = usMax;
+  cal.trim = constrain(trim, -127, 127);
+  cal.invert = invert ? 1 : 0;
+  if(!servoSetCal(id, cal)){
+    servoLoadCal(id); //the record in EEPROM stays
+    return false;
+  }
+  eeprom_write_block(&cal, (void*)(SERVO_CAL_ADDR + (id-1)*sizeof(servoCal_t)), sizeof(servoCal_t));
+  return true;
+}
+
+//degree to pulse(us)
+int BOXZ::servoUs(int id, int pos){
+  pos = constrain(pos, 0, 180);
+  return _servoUs0[id-1] + (pos*_servoScale[id-1])/16;
+}
+
+void BOXZ::servoWrite(int id, int pos){
+  if(id < 1 || id > _servoCount) return;
+  servoOut(id, servoUs(id, pos));
+}
+
+//pulse(us) back to degree with the same calibration
+int BOXZ::servoRead(int id){
+  if(id < 1 || id > _servoCount) return 0;
+  int scale = _servoScale[id-1];
+#if BOXZ_PCA9685
+  int us = _servoPCA ? pca.pulse(id-1) : servoObj(id)->readMicroseconds();
+#else
+  int us = servoObj(id)->readMicroseconds();
+#endif
+  int diff = (us - _servoUs0[id-1])*16;
+  return constrain((diff + scale/2)/scale, 0, 180);
+}
+
+/****************************idle function for Servo*********************************/
+/*
+ A servo at rest is detached after idleTime(ms): the pin is not pulsed any more, the servo
+ releases torque and the timer interrupt stops when both servos are detached.
+ The next command attaches it again with the last position.
+ */
+void BOXZ::servoIdle(unsigned long idleTime){
+  _servoIdle = idleTime;
+}
+
+void BOXZ::servoUpdate(){
+  if(_servoIdle > 0){
+    unsigned long now = millis();
+    for(int id = 1; id <= _servoCount; id++){
+      if(bitRead(_servoOn, id-1) && now - _servoMove[id-1] >= _servoIdle) servoDetach(id);
+    }
+  }
+#if BOXZ_PCA9685
+  if(_servoPCA) pca.update(); //one burst with all changed channels
+#endif
+}
+
+int BOXZ::servoDuty(int id){
+  if(id < 1 || id > _servoCount) return 0;
+  unsigned long now = millis();
+  unsigned long onTime = _servoOnTime[id-1];
+  if(bitRead(_servoOn, id-1)) onTime += now - _servoOnSince[id-1];
+  unsigned long total = (now - _servoStart)/100;
+  if(total == 0) return 100;
+  return min(onTime/total, 100UL);
+}
+
+unsigned long BOXZ::servoISRCount(){
+  return Servo::isrCount();
+}
+
+Servo *BOXZ::servoObj(int id){
+  return id == 1 ? &servo01 : &servo02;
+}
+
+void BOXZ::servoAttach(int id){
+  //PCA9685 channel is switched on by the next pulse
+  if(!_servoPCA){
+    int us0 = servoUs(id, 0);
+    int us180 = servoUs(id, 180);
+    servoObj(id)->attach(_servoPin[id-1], min(us0, us180), max(us0, us180));
+  }
+  bitSet(_servoOn, id-1);
+  _servoOnSince[id-1] = millis();
+  _servoMove[id-1] = _servoOnSince[id-1];
+}
+
+void BOXZ::servoDetach(int id){
+#if BOXZ_PCA9685
+  if(_servoPCA) pca.off(id-1);
+  else servoObj(id)->detach();
+#else
+  servoObj(id)->detach();
+#endif
+  bitClear(_servoOn, id-1);
+  _servoOnTime[id-1] += millis() - _servoOnSince[id-1];
+}
+
+//every servo output pass here, value is pulse(us)
+void BOXZ::servoOut(int id, int us){
+  if(!bitRead(_servoOn, id-1)) servoAttach(id);
+#if BOXZ_PCA9685
+  if(_servoPCA) pca.setPulse(id-1, us);
+  else servoObj(id)->writeMicroseconds(us);
+#else
+  servoObj(id)->writeMicroseconds(us);
+#endif
+  _servoMove[id-1] = millis();
+}
+
+//wait one frame of servo action, PCA9685 sends all servo changed in this frame at once
+void BOXZ::servoWait(){
+#if BOXZ_PCA9685
+  if(_servoPCA) pca.update();
+#endif
+  delay(_servoDelay);
 }
 
 
@@ -296,8 +490,8 @@ void BOXZ::initServo(int pin01,int pin02, int posMin, int posMax){
 void BOXZ::servo01Up(){
   for(_servoPos01 = _servoPosMax; _servoPos01 >= _servoPosMin; _servoPos01 -= 1)  
   {                                
-    servo01.write(_servoPos01);          
-    delay(_servoDelay);                       
+    servoWrite(1, _servoPos01);          
+    servoWait();                       
   } 
 }
 
@@ -305,8 +499,8 @@ void BOXZ::servo01Up(){
 void BOXZ::servo01Down(){
   for(_servoPos01 = _servoPosMin; _servoPos01 <= _servoPosMax; _servoPos01 += 1)  
   {                                
-    servo01.write(_servoPos01);          
-    delay(_servoDelay);                       
+    servoWrite(1, _servoPos01);          
+    servoWait();                       
   } 
 }
 
@@ -314,8 +508,8 @@ void BOXZ::servo01Down(){
 void BOXZ::servo02Up(){
   for(_servoPos02 = _servoPosMin; _servoPos02 <= _servoPosMax; _servoPos02 += 1)  
   {                                
-    servo02.write(_servoPos02);          
-    delay(_servoDelay);                       
+    servoWrite(2, _servoPos02);          
+    servoWait();                       
   } 
 }
 
@@ -323,8 +517,8 @@ void BOXZ::servo02Up(){
 void BOXZ::servo02Down(){
   for(_servoPos02 = _servoPosMax; _servoPos02 >= _servoPosMin; _servoPos02 -= 1)  
   {                                
-    servo02.write(_servoPos02);          
-    delay(_servoDelay);                       
+    servoWrite(2, _servoPos02);          
+    servoWait();                       
   } 
 }
 
@@ -333,17 +527,17 @@ void BOXZ::servo02Down(){
 //Left hand up(type 1 = step; type 2 = consecutive; else default mode)
 void BOXZ::servo01Up(int type){
   if(type == 1){
-    _servoPos01 = servo01.read();
+    _servoPos01 = servoRead(1);
     _servoPos01 -=10;  
     _servoPos01 = max(_servoPos01,_servoPosMin);
-    servo01.write(_servoPos01);          
-    delay(_servoDelay);  
+    servoWrite(1, _servoPos01);          
+    servoWait();  
   }  
   else if(type == 2){
-    for(_servoPos01 = servo01.read(); _servoPos01 >= _servoPosMin; _servoPos01 -= 1)  
+    for(_servoPos01 = servoRead(1); _servoPos01 >= _servoPosMin; _servoPos01 -= 1)  
     {                                
-      servo01.write(_servoPos01);          
-      delay(_servoDelay);                       
+      servoWrite(1, _servoPos01);          
+      servoWait();                       
     } 
   }
   else{
@@ -354,17 +548,17 @@ void BOXZ::servo01Up(int type){
 //Left hand down(type 1 = step; type 2 = consecutive; else default mode)
 void BOXZ::servo01Down(int type){
   if(type == 1){
-    _servoPos01 = servo01.read();
+    _servoPos01 = servoRead(1);
     _servoPos01 +=10;  
     _servoPos01 = min(_servoPos01,_servoPosMax);
-    servo01.write(_servoPos01);          
-    delay(_servoDelay); 
+    servoWrite(1, _servoPos01);          
+    servoWait(); 
   }  
   else if(type == 2){
-    for(_servoPos01 = servo01.read(); _servoPos01 <= _servoPosMax; _servoPos01 += 1)  
+    for(_servoPos01 = servoRead(1); _servoPos01 <= _servoPosMax; _servoPos01 += 1)  
     {                                
-      servo01.write(_servoPos01);          
-      delay(_servoDelay);                       
+      servoWrite(1, _servoPos01);          
+      servoWait();                       
     } 
   }
   else{
@@ -376,17 +570,17 @@ void BOXZ::servo01Down(int type){
 //Right hand up(type 1 = step; type 2 = consecutive; else default mode)
 void BOXZ::servo02Up(int type){
   if(type == 1){
-    _servoPos02 = servo02.read();
+    _servoPos02 = servoRead(2);
     _servoPos02 +=10;  
     _servoPos02 = min(_servoPos02,_servoPosMax);
-    servo02.write(_servoPos02);          
-    delay(_servoDelay); 
+    servoWrite(2, _servoPos02);          
+    servoWait(); 
   }  
   else if(type == 2){
-    for(_servoPos02 = servo02.read(); _servoPos02 <= _servoPosMax; _servoPos02 += 1)  
+    for(_servoPos02 = servoRead(2); _servoPos02 <= _servoPosMax; _servoPos02 += 1)  
     {                                
-      servo02.write(_servoPos02);          
-      delay(_servoDelay);                       
+      servoWrite(2, _servoPos02);          
+      servoWait();                       
     } 
   }
   else{
@@ -397,17 +591,17 @@ void BOXZ::servo02Up(int type){
 //Right hand down(type 1 = step; type 2 = consecutive; else default mode)
 void BOXZ::servo02Down(int type){
   if(type == 1){
-    _servoPos02 = servo02.read();
+    _servoPos02 = servoRead(2);
     _servoPos02 -=10;  
     _servoPos02 = max(_servoPos02,_servoPosMin);
-    servo02.write(_servoPos02);          
-    delay(_servoDelay); 
+    servoWrite(2, _servoPos02);          
+    servoWait(); 
   }  
   else if(type == 2){
-    for(_servoPos02 = servo02.read(); _servoPos02 >= _servoPosMin; _servoPos02 -= 1)  
+    for(_servoPos02 = servoRead(2); _servoPos02 >= _servoPosMin; _servoPos02 -= 1)  
     {                                
-      servo02.write(_servoPos02);          
-      delay(_servoDelay);                       
+      servoWrite(2, _servoPos02);          
+      servoWait();                       
     } 
   }
   else{
@@ -468,28 +662,30 @@ void BOXZ::servoRaw(unsigned long data){
   _servoTar02 = highByte(data);
   _servoAct01 = bitRead(data, 16);
   _servoAct02 = bitRead(data, 17);
-  _servoPos01 = servo01.read();
-  _servoPos02 = servo02.read();
+  _servoPos01 = servoRead(1);
+  _servoPos02 = servoRead(2);
   //Global variable
-  _servoPosMax = SERVO_POSMAX;
-  _servoPosMin = SERVO_POSMIN;
   _servoFrame = SERVO_FRAME;
-  //limit value from 20 to 160 degree
+  //limit value to range of initServo()
   _servoTar01 = min(_servoTar01,_servoPosMax);
   _servoTar01 = max(_servoTar01,_servoPosMin);
   _servoTar02 = min(_servoTar02,_servoPosMax);
   _servoTar02 = max(_servoTar02,_servoPosMin); 
-  //Calculate degree
+  //Calculate pulse
   if(_servoAct01 ==1 || _servoAct02 ==1){
-    _servoFra01 = int((10*(_servoTar01 - _servoPos01))/_servoFrame);
-    _servoFra02 = int((10*(_servoTar02 - _servoPos02))/_servoFrame);
+    int start01 = servoUs(1, _servoPos01);
+    int start02 = servoUs(2, _servoPos02);
+    _servoFra01 = servoUs(1, _servoTar01) - start01; //pulse distance
+    _servoFra02 = servoUs(2, _servoTar02) - start02;
     for(int i = 0;i <= _servoFrame; i++){
-      _servoDis01 = 600+10*_servoPos01 + i*_servoFra01;
-      _servoDis02 = 600+10*_servoPos02 + i*_servoFra02;
-      if(_servoAct01 ==1) servo01.writeMicroseconds(_servoDis01); 
-      if(_servoAct02 ==1) servo02.writeMicroseconds(_servoDis02);   
-      delay(_servoDelay);  
+      _servoDis01 = start01 + long(_servoFra01)*i/_servoFrame;
+      _servoDis02 = start02 + long(_servoFra02)*i/_servoFrame;
+      if(_servoAct01 ==1) servoOut(1, _servoDis01); 
+      if(_servoAct02 ==1) servoOut(2, _servoDis02);   
+      servoWait();  
     }
+    if(_servoAct01 ==1) _servoPos01 = _servoTar01;
+    if(_servoAct02 ==1) _servoPos02 = _servoTar02;
   }
 }
 
@@ -632,24 +828,26 @@ void BOXZ::servoCom(int keyword){
 //servoTar02 is the servo degree of Right hand
 void BOXZ::servoCom(int servoTar01, int servoTar02){
   //Global variable
-  _servoPosMax = SERVO_POSMAX;
-  _servoPosMin = SERVO_POSMIN;
   _servoFrame = SERVO_FRAME;
-  //limit value from 20 to 160 degree
+  //limit value to range of initServo()
   servoTar01 = min(servoTar01,_servoPosMax);
   servoTar01 = max(servoTar01,_servoPosMin);
   servoTar02 = min(servoTar02,_servoPosMax);
   servoTar02 = max(servoTar02,_servoPosMin); 
-  //Calculate degree
-  _servoFra01 = int((10*(servoTar01 - _servoPos01))/_servoFrame);
-  _servoFra02 = int((10*(servoTar02 - _servoPos02))/_servoFrame);
+  //Calculate pulse
+  int start01 = servoUs(1, _servoPos01);
+  int start02 = servoUs(2, _servoPos02);
+  _servoFra01 = servoUs(1, servoTar01) - start01; //pulse distance
+  _servoFra02 = servoUs(2, servoTar02) - start02;
   for(int i = 0;i <= _servoFrame; i++){
-    _servoDis01 = 600+10*_servoPos01 + i*_servoFra01;
-    _servoDis02 = 600+10*_servoPos02 + i*_servoFra02;
-    servo01.writeMicroseconds(_servoDis01); 
-    servo02.writeMicroseconds(_servoDis02);   
-    delay(_servoDelay);  
+    _servoDis01 = start01 + long(_servoFra01)*i/_servoFrame;
+    _servoDis02 = start02 + long(_servoFra02)*i/_servoFrame;
+    servoOut(1, _servoDis01); 
+    servoOut(2, _servoDis02);   
+    servoWait();  
   }
+  _servoPos01 = servoTar01;
+  _servoPos02 = servoTar02;
 }
 
 BOXZ boxz;
@@ -13,6 +13,46 @@ BOXZ.h - Library for general robot control.
  */
 
 /*  Modified record:
+  Update: 20261018
+  1. add BProfile, min/avg/max and histogram of loop stages measured by BOXZ_PROBE()
+     (set BOXZ_PROFILE to 1, with 0 the probes are removed)
+
+  Update: 20261018
+  1. add BTask, cooperative scheduler, tasks run at their own period by priority
+     with missed start and overrun counters
+
+  Update: 20261018
+  1. add BSerial, Serial1 with a 256 byte interrupt fed receive ring, overrun counter and line ends
+     (set BOXZ_SERIAL to 1, USART1 interrupts are used by the driver, not compatible with Serial1)
+
+  Update: 20261018
+  1. add BoxzCommand::merge(), fields of a newer command replace the older ones
+
+  Update: 20261018
+  1. BFRAME_REPORT carries id/value pairs, the ids of the telemetry fields of the examples
+
+  Update: 20261018
+  1. add BFrame, binary frames with CRC-8 for the app link, a broken frame is dropped alone
+  2. add BoxzCommand::parseBinary() for the payload of command frames
+
+  Update: 20261018
+  1. add BoxzCommand, decoder of app commands(JSON or MessagePack) generated by
+     tools/gen_command.py from tools/boxz_command.txt
+
+  Update: 20261018
+  1. add PCA9685 I2C servo/PWM driver backend for BOXZ MAX, initServoPCA() and pwmWrite()
+     (set BOXZ_PCA9685 to 1, TWI interrupt is used by the driver, not compatible with Wire library)
+
+  Update: 20261018
+  1. add servo calibration(pulse range, center trim, direction) stored in EEPROM, servoCalibrate()
+  2. add servoWrite() and servoRead(), one degree to pulse conversion for all servo functions
+  3. servoRaw() and servoCom() keep range limit of initServo()
+  4. calibration limited to the pulses Servo::attach() can store, servoCalibrate() returns false otherwise
+
+  Update: 20261018
+  1. add servoIdle() and servoUpdate(), servo is detached after resting and attached again by next command
+  2. add servoDuty() and servoISRCount() for measurement
+
   Update: 20141123
   1. add SPEED_FIX1 amd SPEED_FIX2 for motorCom
 
@@ -68,14 +108,30 @@ BOXZ.h - Library for general robot control.
 
 #include <Servo.h> 
 #include <SoftwareSerial.h>
+#include <avr/eeprom.h>
+#include "PCA9685.h"
+#include "BoxzCommand.h"
+#include "BFrame.h"
+#include "BSerial.h"
+#include "BTask.h"
+#include "BProfile.h"
 
 //if DEBUG = 1 show info; DEBUG = 2 show RAW
 #define DEBUG			0
 #define PREACCELERATION	1  //not ready yet
+#define BOXZ_PCA9685	0  //1: servo on PCA9685 I2C driver(BOXZ MAX)
+#define BOXZ_SERIAL		0  //1: Serial1 received into the BSerial ring(ROMEO BLE), bserial instead of Serial1
+#define BOXZ_PROFILE	0  //1: BOXZ_PROBE() records into bprofile, 0: no probes
 #define DEFAULT_SPEED	255
 #define SPEED_FIX1 0x50  //fixed speed for turn left and right
 #define SPEED_FIX2 0x70  //fixed speed for q,e,z,x
 
+#if BOXZ_PROFILE
+#define BOXZ_PROBE(stage)	BProbe _probe(stage)  //time to the end of the block
+#else
+#define BOXZ_PROBE(stage)
+#endif
+
 /******Pins definitions for L293, L298N and A3906*************/
 //_driverMode = 4
 //2 control pin and 2 speed pin
@@ -99,6 +155,29 @@ BOXZ.h - Library for general robot control.
 #define SERVO_POSMAX 		140; // max position is 180
 #define SERVO_DELAY 		1;  //[modifid]delay speed of hand
 #define SERVO_FRAME 		20;  //[modifid]
+#define SERVO_IDLE 		0    // ms at rest before servo is detached, 0: always hold
+#if BOXZ_PCA9685
+#define SERVO_NUM 		10   // PCA9685 channel 0-9, channel 10-15 for pwmWrite()
+#else
+#define SERVO_NUM 		2    // servo01 and servo02
+#endif
+#define SERVO_US_MIN 		600  // default pulse(us) of 0 degree
+#define SERVO_US_MAX 		2400 // default pulse(us) of 180 degree
+#define SERVO_US_LOW 		36   // 0 degree pulse range of Servo::attach(), (544 - us)/4 in int8_t
+#define SERVO_US_LOW_MAX 	1056
+#define SERVO_US_HIGH_MIN 	1892 // 180 degree pulse range of Servo::attach(), (2400 - us)/4 in int8_t
+#define SERVO_US_HIGH 		2912
+#define SERVO_CAL_ADDR 		0x10 // EEPROM address of servo calibration, one record per servo
+#define SERVO_CAL_MAGIC 	0xB5 // marks a valid calibration record
+
+//Servo calibration record in EEPROM
+typedef struct {
+  uint8_t magic;   // SERVO_CAL_MAGIC if valid
+  int16_t usMin;   // pulse(us) of 0 degree
+  int16_t usMax;   // pulse(us) of 180 degree
+  int8_t trim;     // center offset(us)
+  uint8_t invert;  // 1: reverse direction
+} servoCal_t;
 
 /**Class for motor control**/
 class BOXZ
@@ -132,6 +211,12 @@ public:
   void initServo();
   void initServo(int pin01,int pin02);
   void initServo(int pin01,int pin02, int posMin, int posMax);
+#if BOXZ_PCA9685
+  PCA9685 pca; // create PCA9685 object for BOXZ MAX
+  boolean initServoPCA(); //servo 1 to SERVO_NUM on PCA9685 channel 0 to SERVO_NUM-1
+  boolean initServoPCA(uint8_t addr);
+  void pwmWrite(int channel, int value); //PCA9685 channel duty from 0 to 4095, for LED
+#endif
   void servo01Up();
   void servo02Up();
   void servo01Down();
@@ -144,7 +229,13 @@ public:
   void servoCom(int posL, int posR); 
   void servoRaw(unsigned long data);
   void servoRaws(String datas);
-
+  void servoWrite(int id, int pos); //servo 1/2 to degree, with calibration
+  int servoRead(int id); //degree of servo 1/2, with calibration
+  boolean servoCalibrate(int id, int usMin, int usMax, int trim, boolean invert); //save to EEPROM, false if out of range
+  void servoIdle(unsigned long idleTime); //detach servo after idleTime(ms) at rest, 0 disable
+  void servoUpdate(); //call it every loop for idle detach
+  int servoDuty(int id); //percentage of time servo 1/2 was pulsed since initServo()
+  unsigned long servoISRCount(); //number of servo timer interrupts
 
 
 private:
@@ -177,10 +268,30 @@ private:
   int _servoAct02; //actived
   int _servoDis01; //Distance
   int _servoDis02; //Distance
-  int _servoFra01; //Frame Distance
-  int _servoFra02; //Frame Distance
+  int _servoFra01; //Pulse Distance
+  int _servoFra02; //Pulse Distance
   int _servoDelay;
   int _servoFrame;
+  int _servoPin[SERVO_NUM];
+  int _servoCount; //servo number of current backend
+  boolean _servoPCA; //servo on PCA9685
+  uint16_t _servoOn; //attached servo, bit 0 is servo 1
+  unsigned long _servoIdle; //idle time before detach
+  unsigned long _servoMove[SERVO_NUM]; //time of last command
+  unsigned long _servoOnSince[SERVO_NUM]; //time of attach
+  unsigned long _servoOnTime[SERVO_NUM]; //accumulate attached time
+  unsigned long _servoStart; //time of initServo
+  int _servoUs0[SERVO_NUM]; //pulse(us) of 0 degree, trim included
+  int _servoScale[SERVO_NUM]; //us per degree * 16, negative if inverted
+  Servo *servoObj(int id);
+  void servoBegin(int posMin, int posMax);
+  void servoWait();
+  void servoLoadCal(int id);
+  boolean servoSetCal(int id, const servoCal_t &cal);
+  int servoUs(int id, int pos);
+  void servoAttach(int id);
+  void servoDetach(int id);
+  void servoOut(int id, int value);
 };
 
 extern BOXZ boxz;
@@ -0,0 +1,128 @@
+/*
+BProfile.cpp - Time spent in the stages of the BOXZ main loop.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+ */
+
+/*Define
+
+ - Cost of a probe
+ Two micros() calls, a few shifts for the bin and the adds of record(), about
+ 10us on a 16MHz AVR. Times are kept in 16 bits, longer runs count as 65535us.
+ */
+#include "BOXZ.h"
+
+#if BOXZ_PROFILE
+
+BProfile::BProfile()
+{
+  for(uint8_t stage = 0; stage < BPROFILE_STAGES; stage++) _name[stage] = NULL;
+  reset();
+}
+
+void BProfile::reset()
+{
+  for(uint8_t stage = 0; stage < BPROFILE_STAGES; stage++){
+    _count[stage] = 0;
+    _sum[stage] = 0;
+    _min[stage] = 0xFFFF;
+    _max[stage] = 0;
+    for(uint8_t index = 0; index < BPROFILE_BINS; index++) _bins[stage][index] = 0;
+  }
+}
+
+void BProfile::name(uint8_t stage, const char *name)
+{
+  if(stage < BPROFILE_STAGES) _name[stage] = name;
+}
+
+const char* BProfile::name(uint8_t stage)
+{
+  if(stage >= BPROFILE_STAGES) return NULL;
+  return _name[stage];
+}
+
+void BProfile::record(uint8_t stage, unsigned long time)
+{
+  if(stage >= BPROFILE_STAGES) return;
+  unsigned int us = min(time, 0xFFFFUL);
+  if(_count[stage] == 0xFFFF || (_sum[stage] & 0x80000000UL)){
+    //halve all counts, the average stays
+    _count[stage] >>= 1;
+    _sum[stage] >>= 1;
+    for(uint8_t index = 0; index < BPROFILE_BINS; index++) _bins[stage][index] >>= 1;
+  }
+  _count[stage]++;
+  _sum[stage] += us;
+  if(us < _min[stage]) _min[stage] = us;
+  if(us > _max[stage]) _max[stage] = us;
+
+  uint8_t index = 0;
+  us >>= 4; //first bin below 16us
+  while(us && index < BPROFILE_BINS - 1){
+    us >>= 1;
+    index++;
+  }
+  _bins[stage][index]++;
+}
+
+unsigned int BProfile::count(uint8_t stage)
+{
+  if(stage >= BPROFILE_STAGES) return 0;
+  return _count[stage];
+}
+
+unsigned int BProfile::minimum(uint8_t stage)
+{
+  if(stage >= BPROFILE_STAGES || _count[stage] == 0) return 0;
+  return _min[stage];
+}
+
+unsigned int BProfile::average(uint8_t stage)
+{
+  if(stage >= BPROFILE_STAGES || _count[stage] == 0) return 0;
+  return (_sum[stage] + _count[stage] / 2) / _count[stage];
+}
+
+unsigned int BProfile::maximum(uint8_t stage)
+{
+  if(stage >= BPROFILE_STAGES) return 0;
+  return _max[stage];
+}
+
+uint8_t BProfile::bin(uint8_t stage, uint8_t index)
+{
+  if(stage >= BPROFILE_STAGES || index >= BPROFILE_BINS || _count[stage] == 0) return 0;
+  return (_bins[stage][index] * 100UL + _count[stage] / 2) / _count[stage];
+}
+
+uint8_t BProfile::snapshot(uint8_t stage, uint8_t *buffer)
+{
+  if(stage >= BPROFILE_STAGES) return 0;
+  unsigned int value[3] = {minimum(stage), average(stage), maximum(stage)};
+  uint8_t len = 0;
+  buffer[len++] = stage;
+  for(uint8_t i = 0; i < 3; i++){
+    buffer[len++] = lowByte(value[i]);
+    buffer[len++] = highByte(value[i]);
+  }
+  for(uint8_t index = 0; index < BPROFILE_BINS; index++) buffer[len++] = bin(stage, index);
+  return len;
+}
+
+BProbe::BProbe(uint8_t stage)
+{
+  _stage = stage;
+  _start = micros();
+}
+
+BProbe::~BProbe()
+{
+  bprofile.record(_stage, micros() - _start);
+}
+
+BProfile bprofile;
+
+#endif
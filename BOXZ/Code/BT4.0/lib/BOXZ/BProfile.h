@@ -0,0 +1,84 @@
+/*
+BProfile.h - Time spent in the stages of the BOXZ main loop.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ BOXZ_PROBE(stage) at the start of a block measures the block with micros()
+ and records it into the stage of bprofile: number of runs, min, average, max
+ and a histogram of BPROFILE_BINS bins, each twice as wide as the one before.
+ The bins are below 16us, 16-31us, 32-63us, ... and 1024us or more.
+
+ With BOXZ_PROFILE 0 in BOXZ.h BOXZ_PROBE() is empty and bprofile does not
+ exist, the probes cost nothing.
+
+ When a count would overflow all counts of the stage are halved, so the
+ values follow the recent runs rather than stopping.
+
+ The methods are:
+
+ name()       - Set or get the name of a stage.
+ record()     - Add one run of a stage in microseconds, used by BOXZ_PROBE().
+ count()      - Runs recorded(halved at overflow).
+ minimum()    - Shortest run in microseconds.
+ average()    - Average run in microseconds.
+ maximum()    - Longest run in microseconds, up to 65535.
+ snapshot()   - Write the BPROFILE_SNAPSHOT bytes of a stage for a BFrame:
+                |stage|min low|min high|avg low|avg high|max low|max high|bins|,
+                bins in percent of the runs.
+ reset()      - Clear all stages.
+ */
+
+#ifndef __BPROFILE_H__
+#define __BPROFILE_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define BPROFILE_STAGES		6	// stages of bprofile
+#define BPROFILE_BINS		8	// histogram bins, the first below 16us
+#define BPROFILE_SNAPSHOT	(7 + BPROFILE_BINS)	// bytes of snapshot(), fits a BFrame
+
+class BProfile
+{
+public:
+  BProfile();
+  void name(uint8_t stage, const char *name);
+  const char* name(uint8_t stage);
+  void record(uint8_t stage, unsigned long time);
+  unsigned int count(uint8_t stage);
+  unsigned int minimum(uint8_t stage);
+  unsigned int average(uint8_t stage);
+  unsigned int maximum(uint8_t stage);
+  uint8_t bin(uint8_t stage, uint8_t index); //percent of the runs
+  uint8_t snapshot(uint8_t stage, uint8_t *buffer);
+  void reset();
+
+private:
+  const char *_name[BPROFILE_STAGES];
+  unsigned int _count[BPROFILE_STAGES];
+  unsigned long _sum[BPROFILE_STAGES]; //us
+  unsigned int _min[BPROFILE_STAGES];
+  unsigned int _max[BPROFILE_STAGES];
+  unsigned int _bins[BPROFILE_STAGES][BPROFILE_BINS];
+};
+
+//measures from its construction to the end of the block
+class BProbe
+{
+public:
+  BProbe(uint8_t stage);
+  ~BProbe();
+
+private:
+  uint8_t _stage;
+  unsigned long _start;
+};
+
+extern BProfile bprofile;
+
+#endif
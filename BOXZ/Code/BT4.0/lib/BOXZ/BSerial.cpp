@@ -0,0 +1,196 @@
+/*
+BSerial.cpp - Serial1 with a large receive ring for the BLE link of BOXZ.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+ */
+
+/*Define
+
+ - Receive ring
+ The RX interrupt stores at rxHead, read() takes from rxTail. A byte that finds
+ the ring full is dropped and counted, like a hardware overrun(DOR1).
+ Indexes are 16 bit, the main side reads rxHead with interrupts off.
+
+ - Line ends
+ The RX interrupt also notes the ring index of every '\n' in lineEnd[], so
+ readLine() copies a whole line without looking at each byte. When lineEnd[]
+ is full, further line ends are only counted(lineMissed) and readLine()
+ looks for them itself.
+
+ - Transmit with interrupts off
+ write() waits for room in the ring and flush() for the ring to empty, which
+ the UDRE interrupt never gives while interrupts are off(in an ISR or under
+ cli()). Then both poll UDRE1 and write UDR1 themselves, like HardwareSerial.
+ */
+#include "BOXZ.h"
+
+#if BOXZ_SERIAL && defined(UDR1)
+#include <avr/interrupt.h>
+
+#define RX_MASK		(BSERIAL_RX_SIZE - 1)
+#define TX_MASK		(BSERIAL_TX_SIZE - 1)
+#define LINE_MASK	(BSERIAL_LINES - 1)
+
+static volatile uint8_t rxRing[BSERIAL_RX_SIZE];
+static volatile uint16_t rxHead = 0;
+static volatile uint16_t rxTail = 0;
+static volatile unsigned int rxOverruns = 0;
+static volatile uint16_t lineEnd[BSERIAL_LINES]; //ring index of '\n'
+static volatile uint8_t lineHead = 0;
+static volatile uint8_t lineTail = 0;
+static volatile uint8_t lineMissed = 0; //line ends not in lineEnd[]
+
+static volatile uint8_t txRing[BSERIAL_TX_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+
+BSerial bserial;
+
+ISR(USART1_RX_vect)
+{
+  if(UCSR1A & _BV(DOR1)) rxOverruns++; //lost in hardware already
+  uint8_t ch = UDR1;
+  uint16_t next = (rxHead + 1) & RX_MASK;
+  if(next == rxTail){
+    rxOverruns++;
+    return;
+  }
+  rxRing[rxHead] = ch;
+  if(ch == '\n'){
+    uint8_t nextLine = (lineHead + 1) & LINE_MASK;
+    if(nextLine != lineTail && !lineMissed){
+      lineEnd[lineHead] = rxHead;
+      lineHead = nextLine;
+    }
+    else if(lineMissed < 255) lineMissed++;
+  }
+  rxHead = next;
+}
+
+ISR(USART1_UDRE_vect)
+{
+  if(txHead == txTail){
+    UCSR1B &= ~_BV(UDRIE1);
+    return;
+  }
+  UDR1 = txRing[txTail];
+  txTail = (txTail + 1) & TX_MASK;
+}
+
+static uint16_t rxCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint16_t count = (rxHead - rxTail) & RX_MASK;
+  SREG = oldSREG;
+  return count;
+}
+
+void BSerial::begin(unsigned long baud)
+{
+  //double speed, same divisor as HardwareSerial
+  uint16_t ubrr = (F_CPU / 4 / baud - 1) / 2;
+  UCSR1A = _BV(U2X1);
+  UBRR1H = ubrr >> 8;
+  UBRR1L = ubrr;
+  UCSR1C = _BV(UCSZ11) | _BV(UCSZ10); //8N1
+  UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+}
+
+int BSerial::available()
+{
+  return rxCount();
+}
+
+int BSerial::peek()
+{
+  if(rxCount() == 0) return -1;
+  return rxRing[rxTail];
+}
+
+int BSerial::read()
+{
+  if(rxCount() == 0) return -1;
+  uint8_t ch = rxRing[rxTail];
+  uint8_t oldSREG = SREG;
+  cli();
+  if(ch == '\n'){
+    if(lineHead != lineTail && lineEnd[lineTail] == rxTail) lineTail = (lineTail + 1) & LINE_MASK;
+    else if(lineMissed) lineMissed--;
+  }
+  rxTail = (rxTail + 1) & RX_MASK;
+  SREG = oldSREG;
+  return ch;
+}
+
+uint8_t BSerial::lines()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t count = ((lineHead - lineTail) & LINE_MASK) + lineMissed;
+  SREG = oldSREG;
+  return count;
+}
+
+//copies the next line with its '\n' and a 0, a longer line is cut to size - 1
+//bytes but read up to its end, returns the bytes copied, 0 if no line is complete
+size_t BSerial::readLine(char *buffer, size_t size)
+{
+  if(size == 0 || lines() == 0) return 0;
+  uint8_t oldSREG = SREG;
+  cli();
+  boolean noted = lineHead != lineTail;
+  uint16_t end = lineEnd[lineTail];
+  SREG = oldSREG;
+  if(!noted){
+    //line end only counted, find it
+    end = rxTail;
+    while(rxRing[end] != '\n') end = (end + 1) & RX_MASK;
+  }
+  size_t len = ((end - rxTail) & RX_MASK) + 1;
+  size_t copied = 0;
+  while(len--){
+    int ch = read();
+    if(copied < size - 1) buffer[copied++] = ch;
+  }
+  buffer[copied] = 0;
+  return copied;
+}
+
+unsigned int BSerial::overruns()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned int count = rxOverruns;
+  SREG = oldSREG;
+  return count;
+}
+
+//sends the oldest byte of the ring by hand when the UDRE interrupt cannot run
+static void txPoll()
+{
+  if(bit_is_clear(SREG, SREG_I) && bit_is_set(UCSR1A, UDRE1) && txHead != txTail){
+    UDR1 = txRing[txTail];
+    txTail = (txTail + 1) & TX_MASK;
+  }
+}
+
+size_t BSerial::write(uint8_t ch)
+{
+  uint8_t next = (txHead + 1) & TX_MASK;
+  while(next == txTail) txPoll(); //ring full, the interrupt makes room
+  txRing[txHead] = ch;
+  txHead = next;
+  UCSR1B |= _BV(UDRIE1);
+  return 1;
+}
+
+void BSerial::flush()
+{
+  //like Serial in Arduino 1.0, wait until everything is sent
+  while(txHead != txTail) txPoll();
+}
+
+#endif
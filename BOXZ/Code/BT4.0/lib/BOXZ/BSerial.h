@@ -0,0 +1,58 @@
+/*
+BSerial.h - Serial1 with a large receive ring for the BLE link of BOXZ.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ The 64 byte buffer of Serial1 holds 5.5ms at 115200 baud, less than a
+ blocking servo move. BSerial receives into a BSERIAL_RX_SIZE ring instead,
+ counts bytes lost when it is full, and notes where lines end, so a complete
+ JSON message can be taken in one piece.
+
+ The USART1 interrupts are owned by this driver, do not use Serial1 with it.
+ It is only compiled when BOXZ_SERIAL is 1 in BOXZ.h, on boards with USART1
+ (ROMEO BLE, Leonardo).
+
+ The methods are:
+
+ begin()      - Set baud rate and start receiving.
+ available()  - Bytes received and not read yet.
+ read()       - Next byte, -1 if there is none.
+ lines()      - Complete lines(up to '\n') received and not read yet.
+ readLine()   - Take the next complete line in one piece.
+ overruns()   - Bytes lost because the ring was full.
+ write()      - Queue a byte for sending, waits only while the send ring is full.
+ */
+
+#ifndef __BSERIAL_H__
+#define __BSERIAL_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define BSERIAL_RX_SIZE		256	// bytes of receive ring, power of 2, up to 1024
+#define BSERIAL_TX_SIZE		64	// bytes of send ring, power of 2
+#define BSERIAL_LINES		8	// line ends noted by the interrupt, power of 2
+
+class BSerial : public Stream
+{
+public:
+  void begin(unsigned long baud);
+  virtual int available();
+  virtual int read();
+  virtual int peek();
+  virtual void flush();
+  virtual size_t write(uint8_t ch);
+  using Print::write;
+  uint8_t lines();
+  size_t readLine(char *buffer, size_t size);
+  unsigned int overruns();
+};
+
+extern BSerial bserial;
+
+#endif
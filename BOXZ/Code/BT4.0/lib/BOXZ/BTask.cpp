@@ -0,0 +1,102 @@
+/*
+BTask.cpp - Cooperative fixed rate task scheduler for the BOXZ main loop.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+ */
+
+/*Define
+
+ - Deadline
+ A task is due when micros() reached _next. Times are compared by their signed
+ difference, so the wrap of micros() after 71 minutes does not matter. A start
+ is missed when the task is still not run one period after it, the deadline of
+ a start is the next one.
+ */
+#include "BTask.h"
+
+BTask::BTask()
+{
+  _count = 0;
+}
+
+int8_t BTask::add(BTaskFunction task, unsigned long period, uint8_t priority)
+{
+  if(_count >= BTASK_MAX || task == NULL) return -1;
+  uint8_t id = _count;
+  _task[id] = task;
+  _period[id] = period;
+  _priority[id] = priority;
+  _next[id] = micros(); //due right away
+  _runs[id] = 0;
+  _missed[id] = 0;
+  _overruns[id] = 0;
+  _longest[id] = 0;
+  _count++;
+  return id;
+}
+
+boolean BTask::run()
+{
+  unsigned long now = micros();
+  int8_t best = -1;
+  unsigned long bestLate = 0;
+  for(uint8_t id = 0; id < _count; id++){
+    unsigned long late = now - _next[id];
+    if((long)late < 0) continue; //not due
+    if(best < 0 || _priority[id] < _priority[best] ||
+      (_priority[id] == _priority[best] && late > bestLate)){
+      best = id;
+      bestLate = late;
+    }
+  }
+  if(best < 0) return false;
+
+  uint8_t id = best;
+  if(_period[id] > 0 && bestLate >= _period[id]){
+    //late a whole period or more, skip the lost starts
+    unsigned long lost = bestLate / _period[id];
+    _missed[id] += lost;
+    _next[id] += lost * _period[id];
+  }
+  _next[id] += _period[id];
+  if(_period[id] == 0) _next[id] = now; //every run()
+
+  _task[id]();
+
+  unsigned long time = micros() - now;
+  _runs[id]++;
+  if(time > _longest[id]) _longest[id] = time;
+  if(_period[id] > 0 && time > _period[id]) _overruns[id]++;
+  return true;
+}
+
+uint8_t BTask::count()
+{
+  return _count;
+}
+
+unsigned long BTask::runs(uint8_t id)
+{
+  if(id >= _count) return 0;
+  return _runs[id];
+}
+
+unsigned int BTask::missed(uint8_t id)
+{
+  if(id >= _count) return 0;
+  return _missed[id];
+}
+
+unsigned int BTask::overruns(uint8_t id)
+{
+  if(id >= _count) return 0;
+  return _overruns[id];
+}
+
+unsigned long BTask::longest(uint8_t id)
+{
+  if(id >= _count) return 0;
+  return _longest[id];
+}
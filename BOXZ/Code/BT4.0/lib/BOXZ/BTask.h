@@ -0,0 +1,66 @@
+/*
+BTask.h - Cooperative fixed rate task scheduler for the BOXZ main loop.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ Every task is a function with a period in microseconds and a priority, 0 is
+ the most urgent. run() is called from loop(), it runs one task whose time has
+ come: the one with the best priority, of those the one waiting longest.
+ Tasks are not interrupted, a task that blocks delays all others.
+
+ A task keeps its rate: the next start is one period after the last planned
+ start, not after the time it really ran. If a whole period passed without the
+ task running, the lost starts are counted as missed and skipped. A task with
+ period 0 is due at every run(), give it the last priority.
+
+ The methods are:
+
+ add()        - Add a task, returns its id or -1 if BTASK_MAX tasks are added.
+ run()        - Run the most urgent task that is due, false if none is due.
+ count()      - Number of tasks added.
+ runs()       - Times a task was run.
+ missed()     - Starts of a task skipped because it was late a whole period.
+ overruns()   - Times a task ran longer than its period.
+ longest()    - Longest run of a task in microseconds.
+ */
+
+#ifndef __BTASK_H__
+#define __BTASK_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define BTASK_MAX			8	// tasks of one scheduler
+
+typedef void (*BTaskFunction)();
+
+class BTask
+{
+public:
+  BTask();
+  int8_t add(BTaskFunction task, unsigned long period, uint8_t priority);
+  boolean run();
+  uint8_t count();
+  unsigned long runs(uint8_t id);
+  unsigned int missed(uint8_t id);
+  unsigned int overruns(uint8_t id);
+  unsigned long longest(uint8_t id);
+
+private:
+  uint8_t _count;
+  BTaskFunction _task[BTASK_MAX];
+  unsigned long _period[BTASK_MAX]; //us
+  uint8_t _priority[BTASK_MAX]; //0 first
+  unsigned long _next[BTASK_MAX]; //micros() of next planned start
+  unsigned long _runs[BTASK_MAX];
+  unsigned int _missed[BTASK_MAX];
+  unsigned int _overruns[BTASK_MAX];
+  unsigned long _longest[BTASK_MAX];
+};
+
+#endif
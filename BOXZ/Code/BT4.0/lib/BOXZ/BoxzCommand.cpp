@@ -0,0 +1,514 @@
+/*
+BoxzCommand.cpp - Decoder of BOXZ app commands.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ Generated by tools/gen_command.py from tools/boxz_command.txt, do not edit.
+ */
+
+#include "BoxzCommand.h"
+#include <avr/pgmspace.h>
+
+//keys by slot, a minimal perfect hash of the two chars in 8 bit
+#define KEY_SLOTS	9
+#define KEY_HASH(c0, c1)	((uint8_t) ((unsigned int) ((c0) | 0x20) * 3 ^ (unsigned int) ((c1) | 0x20) * 188) % KEY_SLOTS)
+#define KEY_K1	0
+#define KEY_AT	1
+#define KEY_V2	2
+#define KEY_HP	3
+#define KEY_CF	4
+#define KEY_V1	5
+#define KEY_K2	6
+#define KEY_MP	7
+#define KEY_ME	8
+
+static const char keys[KEY_SLOTS][2] PROGMEM = {
+  {'K', '1'}, {'A', 'T'}, {'V', '2'}, {'H', 'P'}, {'C', 'F'}, {'V', '1'}, {'K', '2'}, {'M', 'P'}, {'M', 'E'}
+};
+
+#define KEY_NONE	0xFF
+#define PACK_DEPTH	4  //nesting of skipped MessagePack values
+
+//a value as far as the fields need it
+#define VALUE_OTHER	0
+#define VALUE_NUMBER	1
+#define VALUE_STRING	2
+
+typedef struct {
+  uint8_t type;
+  long number;  //VALUE_NUMBER, fraction cut off
+  char first;   //VALUE_STRING, first char or 0
+} value_t;
+
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+} cursor_t;
+
+static uint8_t keyLookup(uint8_t c0, uint8_t c1)
+{
+  uint8_t slot = KEY_HASH(c0, c1);
+  if((pgm_read_byte(&keys[slot][0]) | 0x20) != (c0 | 0x20)) return KEY_NONE;
+  if((pgm_read_byte(&keys[slot][1]) | 0x20) != (c1 | 0x20)) return KEY_NONE;
+  return slot;
+}
+
+/************ JSON ***********************/
+
+static int jsonPeek(cursor_t *c)
+{
+  while(c->p < c->end && *c->p <= ' ') c->p++;
+  return c->p < c->end ? *c->p : -1;
+}
+
+static boolean jsonExpect(cursor_t *c, uint8_t ch)
+{
+  if(jsonPeek(c) != ch) return false;
+  c->p++;
+  return true;
+}
+
+//string at c->p, first char into *first, returns its length or -1
+static int jsonString(cursor_t *c, uint8_t *first, uint8_t *second)
+{
+  if(!jsonExpect(c, '"')) return -1;
+  int len = 0;
+  while(c->p < c->end && *c->p != '"'){
+    uint8_t ch = *c->p++;
+    if(ch == '\\'){
+      if(c->p >= c->end) return -1;
+      ch = *c->p++; //escaped char as it is, \u is not needed here
+    }
+    if(len == 0) *first = ch;
+    if(len == 1) *second = ch;
+    len++;
+  }
+  if(c->p >= c->end) return -1;
+  c->p++;
+  return len;
+}
+
+//key and ':', returns KEY_NONE for keys not in the schema, -1 if malformed
+static int jsonKey(cursor_t *c)
+{
+  uint8_t c0 = 0, c1 = 0;
+  int len = jsonString(c, &c0, &c1);
+  if(len < 0 || !jsonExpect(c, ':')) return -1;
+  return len == 2 ? keyLookup(c0, c1) : KEY_NONE;
+}
+
+//number, string or literal; objects and arrays are read over
+static boolean jsonValue(cursor_t *c, value_t *v)
+{
+  v->type = VALUE_OTHER;
+  int ch = jsonPeek(c);
+  if(ch == '"'){
+    uint8_t first = 0, second;
+    if(jsonString(c, &first, &second) < 0) return false;
+    v->type = VALUE_STRING;
+    v->first = first;
+    return true;
+  }
+  if(ch == '-' || (ch >= '0' && ch <= '9')){
+    boolean negative = ch == '-';
+    if(negative) c->p++;
+    long n = 0;
+    while(c->p < c->end && *c->p >= '0' && *c->p <= '9'){
+      if(n < 100000L) n = n * 10 + (*c->p - '0'); //anything larger is out of range anyway
+      c->p++;
+    }
+    //fraction and exponent are cut off
+    while(c->p < c->end && (*c->p == '.' || *c->p == 'e' || *c->p == 'E'
+        || *c->p == '+' || *c->p == '-' || (*c->p >= '0' && *c->p <= '9'))) c->p++;
+    v->type = VALUE_NUMBER;
+    v->number = negative ? -n : n;
+    return true;
+  }
+  uint8_t depth = 0;
+  while(c->p < c->end){
+    ch = *c->p;
+    if(ch == '"'){
+      uint8_t first, second;
+      if(jsonString(c, &first, &second) < 0) return false;
+      if(depth == 0) return true;
+      continue;
+    }
+    if(ch == '{' || ch == '[') depth++;
+    else if(ch == '}' || ch == ']'){
+      if(depth == 0) return true; //end of the enclosing object
+      if(--depth == 0){
+        c->p++;
+        return true;
+      }
+    }
+    else if(ch == ',' && depth == 0) return true;
+    c->p++;
+  }
+  return false;
+}
+
+/************ MessagePack ***********************/
+
+//big endian number of bytes
+static boolean packNumber(cursor_t *c, uint8_t bytes, uint32_t *value)
+{
+  if(c->end - c->p < bytes) return false;
+  *value = 0;
+  while(bytes--) *value = *value << 8 | *c->p++;
+  return true;
+}
+
+static boolean packSkip(cursor_t *c, uint32_t bytes)
+{
+  if((uint32_t) (c->end - c->p) < bytes) return false;
+  c->p += bytes;
+  return true;
+}
+
+//length of a string at c->p, -1 if it is no string
+static long packString(cursor_t *c)
+{
+  if(c->p >= c->end) return -1;
+  uint8_t type = *c->p;
+  uint32_t len;
+  if(type >= 0xa0 && type <= 0xbf){
+    c->p++;
+    return type & 0x1f;
+  }
+  if(type < 0xd9 || type > 0xdb) return -1;
+  c->p++;
+  if(!packNumber(c, 1 << (type - 0xd9), &len)){
+    c->p = c->end; //cut off, nothing more to read
+    return -1;
+  }
+  return len;
+}
+
+//entries of a map or array at c->p, -1 if it is neither
+static long packCount(cursor_t *c, boolean map)
+{
+  if(c->p >= c->end) return -1;
+  uint8_t type = *c->p;
+  uint32_t count;
+  if((type & 0xf0) == (map ? 0x80 : 0x90)){
+    c->p++;
+    return type & 0x0f;
+  }
+  uint8_t first = map ? 0xde : 0xdc;
+  if(type != first && type != first + 1) return -1;
+  c->p++;
+  if(!packNumber(c, type == first ? 2 : 4, &count)){
+    c->p = c->end; //cut off, nothing more to read
+    return -1;
+  }
+  return count;
+}
+
+static boolean packValue(cursor_t *c, value_t *v, uint8_t depth)
+{
+  v->type = VALUE_OTHER;
+  if(c->p >= c->end) return false;
+  long len = packString(c);
+  if(len >= 0){
+    if(c->end - c->p < len) return false;
+    v->type = VALUE_STRING;
+    v->first = len ? *c->p : 0;
+    c->p += len;
+    return true;
+  }
+  for(uint8_t map = 0; map < 2; map++){
+    long count = packCount(c, map);
+    if(count < 0) continue;
+    if(depth >= PACK_DEPTH) return false;
+    value_t skipped;
+    for(count *= map + 1; count > 0; count--){
+      if(!packValue(c, &skipped, depth + 1)) return false;
+    }
+    return true;
+  }
+  if(c->p >= c->end) return false; //a string or map header was cut off
+  uint8_t type = *c->p++;
+  uint32_t u;
+  if(type <= 0x7f || type >= 0xe0){
+    v->type = VALUE_NUMBER;
+    v->number = (int8_t) type;
+    return true;
+  }
+  switch(type){
+  case 0xcc: case 0xcd: case 0xce: //uint 8, 16, 32
+    if(!packNumber(c, 1 << (type - 0xcc), &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = u > 100000UL ? 100000L : (long) u; //out of range anyway
+    return true;
+  case 0xd0: //int 8
+    if(!packNumber(c, 1, &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = (int8_t) u;
+    return true;
+  case 0xd1: //int 16
+    if(!packNumber(c, 2, &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = (int16_t) u;
+    return true;
+  case 0xd2: //int 32
+    if(!packNumber(c, 4, &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = (int32_t) u;
+    return true;
+  case 0xc0: case 0xc2: case 0xc3: //nil, false, true
+    return true;
+  case 0xca: return packSkip(c, 4); //float 32
+  case 0xcb: case 0xcf: case 0xd3: return packSkip(c, 8); //float 64, 64 bit ints
+  case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: //fixext
+    return packSkip(c, 1 + (1 << (type - 0xd4)));
+  case 0xc4: case 0xc5: case 0xc6: //bin
+    return packNumber(c, 1 << (type - 0xc4), &u) && packSkip(c, u);
+  case 0xc7: case 0xc8: case 0xc9: //ext
+    return packNumber(c, 1 << (type - 0xc7), &u) && packSkip(c, u + 1);
+  default:
+    return false;
+  }
+}
+
+//key at c->p, returns KEY_NONE for keys not in the schema, -1 if malformed
+static int packKey(cursor_t *c)
+{
+  long len = packString(c);
+  if(len < 0 || c->end - c->p < len) return -1;
+  const uint8_t *key = c->p;
+  c->p += len;
+  return len == 2 ? keyLookup(key[0], key[1]) : KEY_NONE;
+}
+
+/************ generated from the schema ***********************/
+
+typedef uint8_t groups_t;
+
+//object key to its bit in BoxzCommand.groups, 0 for other keys
+static groups_t groupBit(uint8_t key)
+{
+  switch(key){
+  case KEY_CF: return BOXZ_CF;
+  case KEY_AT: return BOXZ_AT;
+  default: return 0;
+  }
+}
+
+static void store(BoxzCommand *cmd, groups_t group, uint8_t key, const value_t *v)
+{
+  switch(group){
+  case BOXZ_CF:
+    switch(key){
+    case KEY_ME:
+      if(v->type == VALUE_NUMBER && v->number >= -32768 && v->number <= 32767){
+        cmd->me = v->number;
+        cmd->fields |= BOXZ_CF_ME;
+      }
+      break;
+    case KEY_HP:
+      if(v->type == VALUE_NUMBER && v->number >= 1 && v->number <= 255){
+        cmd->hp = v->number;
+        cmd->fields |= BOXZ_CF_HP;
+      }
+      break;
+    case KEY_MP:
+      if(v->type == VALUE_NUMBER && v->number >= 1 && v->number <= 255){
+        cmd->mp = v->number;
+        cmd->fields |= BOXZ_CF_MP;
+      }
+      break;
+    }
+    break;
+  case BOXZ_AT:
+    switch(key){
+    case KEY_V1:
+      if(v->type == VALUE_NUMBER && v->number >= 50 && v->number <= 255){
+        cmd->v1 = v->number;
+        cmd->fields |= BOXZ_AT_V1;
+      }
+      break;
+    case KEY_V2:
+      if(v->type == VALUE_NUMBER && v->number >= 50 && v->number <= 255){
+        cmd->v2 = v->number;
+        cmd->fields |= BOXZ_AT_V2;
+      }
+      break;
+    case KEY_K1:
+      if(v->type == VALUE_STRING && (uint8_t) v->first >= 1){
+        cmd->k1 = v->first;
+        cmd->fields |= BOXZ_AT_K1;
+      }
+      break;
+    case KEY_K2:
+      if(v->type == VALUE_STRING && (uint8_t) v->first >= 1){
+        cmd->k2 = v->first;
+        cmd->fields |= BOXZ_AT_K2;
+      }
+      break;
+    }
+    break;
+  }
+}
+
+//values of the fields bits, in the order of the bits
+static boolean parseFields(BoxzCommand *cmd, uint8_t bits, cursor_t *c)
+{
+  value_t v;
+  if(bits & BOXZ_CF_ME){
+    if(c->end - c->p < 2) return false;
+    v.type = VALUE_NUMBER;
+    v.number = (int16_t) (c->p[0] | c->p[1] << 8);
+    c->p += 2;
+    cmd->groups |= BOXZ_CF;
+    store(cmd, BOXZ_CF, KEY_ME, &v);
+  }
+  if(bits & BOXZ_CF_HP){
+    if(c->p >= c->end) return false;
+    v.type = VALUE_NUMBER;
+    v.number = *c->p++;
+    cmd->groups |= BOXZ_CF;
+    store(cmd, BOXZ_CF, KEY_HP, &v);
+  }
+  if(bits & BOXZ_CF_MP){
+    if(c->p >= c->end) return false;
+    v.type = VALUE_NUMBER;
+    v.number = *c->p++;
+    cmd->groups |= BOXZ_CF;
+    store(cmd, BOXZ_CF, KEY_MP, &v);
+  }
+  if(bits & BOXZ_AT_V1){
+    if(c->p >= c->end) return false;
+    v.type = VALUE_NUMBER;
+    v.number = *c->p++;
+    cmd->groups |= BOXZ_AT;
+    store(cmd, BOXZ_AT, KEY_V1, &v);
+  }
+  if(bits & BOXZ_AT_V2){
+    if(c->p >= c->end) return false;
+    v.type = VALUE_NUMBER;
+    v.number = *c->p++;
+    cmd->groups |= BOXZ_AT;
+    store(cmd, BOXZ_AT, KEY_V2, &v);
+  }
+  if(bits & BOXZ_AT_K1){
+    if(c->p >= c->end) return false;
+    v.type = VALUE_STRING;
+    v.first = *c->p++;
+    cmd->groups |= BOXZ_AT;
+    store(cmd, BOXZ_AT, KEY_K1, &v);
+  }
+  if(bits & BOXZ_AT_K2){
+    if(c->p >= c->end) return false;
+    v.type = VALUE_STRING;
+    v.first = *c->p++;
+    cmd->groups |= BOXZ_AT;
+    store(cmd, BOXZ_AT, KEY_K2, &v);
+  }
+  return c->p == c->end;
+}
+
+void BoxzCommand::merge(const BoxzCommand &newer, groups_t mask)
+{
+  groups |= newer.groups & mask;
+  if(mask & BOXZ_CF){
+    if(newer.fields & BOXZ_CF_ME) me = newer.me;
+    if(newer.fields & BOXZ_CF_HP) hp = newer.hp;
+    if(newer.fields & BOXZ_CF_MP) mp = newer.mp;
+    fields |= newer.fields & (BOXZ_CF_ME | BOXZ_CF_HP | BOXZ_CF_MP);
+  }
+  if(mask & BOXZ_AT){
+    if(newer.fields & BOXZ_AT_V1) v1 = newer.v1;
+    if(newer.fields & BOXZ_AT_V2) v2 = newer.v2;
+    if(newer.fields & BOXZ_AT_K1) k1 = newer.k1;
+    if(newer.fields & BOXZ_AT_K2) k2 = newer.k2;
+    fields |= newer.fields & (BOXZ_AT_V1 | BOXZ_AT_V2 | BOXZ_AT_K1 | BOXZ_AT_K2);
+  }
+}
+
+/************ end of generated code ***********************/
+
+static boolean parseJson(BoxzCommand *cmd, cursor_t *c)
+{
+  value_t v;
+  if(!jsonExpect(c, '{')) return false;
+  if(jsonExpect(c, '}')) return true;
+  do{
+    int key = jsonKey(c);
+    if(key < 0) return false;
+    groups_t group = key == KEY_NONE ? 0 : groupBit(key);
+    if(group && jsonPeek(c) == '{'){
+      cmd->groups |= group;
+      c->p++;
+      if(!jsonExpect(c, '}')){
+        do{
+          int field = jsonKey(c);
+          if(field < 0 || !jsonValue(c, &v)) return false;
+          if(field != KEY_NONE) store(cmd, group, field, &v);
+        }while(jsonExpect(c, ','));
+        if(!jsonExpect(c, '}')) return false;
+      }
+    }
+    else if(!jsonValue(c, &v)) return false;
+  }while(jsonExpect(c, ','));
+  return jsonExpect(c, '}');
+}
+
+static boolean parsePack(BoxzCommand *cmd, cursor_t *c)
+{
+  value_t v;
+  long count = packCount(c, true);
+  if(count < 0) return false;
+  for(; count > 0; count--){
+    int key = packKey(c);
+    if(key < 0) return false;
+    groups_t group = key == KEY_NONE ? 0 : groupBit(key);
+    long fields = group ? packCount(c, true) : -1;
+    if(fields >= 0){
+      cmd->groups |= group;
+      for(; fields > 0; fields--){
+        int field = packKey(c);
+        if(field < 0 || !packValue(c, &v, 1)) return false;
+        if(field != KEY_NONE) store(cmd, group, field, &v);
+      }
+    }
+    else if(!packValue(c, &v, 1)) return false;
+  }
+  return true;
+}
+
+boolean BoxzCommand::parse(const char *frame, size_t len)
+{
+  cursor_t c;
+  c.p = (const uint8_t *) frame;
+  c.end = c.p + len;
+  groups = 0;
+  fields = 0;
+  while(c.p < c.end && *c.p <= ' ') c.p++;
+  if(c.p >= c.end) return false;
+  //a MessagePack map starts with a byte of 0x80 or more, JSON never does
+  if(*c.p >= 0x80 ? parsePack(this, &c) : parseJson(this, &c)) return true;
+  groups = 0; //nothing of a broken frame is used
+  fields = 0;
+  return false;
+}
+
+boolean BoxzCommand::parseBinary(const uint8_t *payload, size_t len)
+{
+  cursor_t c;
+  c.p = payload;
+  c.end = payload + len;
+  groups = 0;
+  fields = 0;
+  uint32_t bits = 0;
+  for(uint8_t i = 0; i < sizeof(fields); i++){ //little endian like the values
+    if(c.p >= c.end) return false;
+    bits |= (uint32_t) *c.p++ << (8 * i);
+  }
+  if(parseFields(this, bits, &c)) return true;
+  groups = 0;
+  fields = 0;
+  return false;
+}
+
@@ -0,0 +1,56 @@
+/*
+BoxzCommand.h - Decoder of BOXZ app commands.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ Generated by tools/gen_command.py from tools/boxz_command.txt, do not edit.
+ */
+
+#ifndef __BOXZ_COMMAND_H__
+#define __BOXZ_COMMAND_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+//objects, bits of BoxzCommand.groups
+#define BOXZ_CF		0x01
+#define BOXZ_AT		0x02
+
+//fields, bits of BoxzCommand.fields
+#define BOXZ_CF_ME	0x01
+#define BOXZ_CF_HP	0x02
+#define BOXZ_CF_MP	0x04
+#define BOXZ_AT_V1	0x08
+#define BOXZ_AT_V2	0x10
+#define BOXZ_AT_K1	0x20
+#define BOXZ_AT_K2	0x40
+
+struct BoxzCommand
+{
+  uint8_t groups; //objects in the frame
+  uint8_t fields; //fields in the frame and in range, the others are not set
+  int16_t me; //CF.ME, message, see processME()
+  uint8_t hp; //CF.HP 1-255, health
+  uint8_t mp; //CF.MP 1-255, magic
+  uint8_t v1; //AT.V1 50-255, speed left, slower does not move
+  uint8_t v2; //AT.V2 50-255, speed right
+  char k1; //AT.K1 1-255, direction key
+  char k2; //AT.K2 1-255, function key
+
+  //decode a JSON or MessagePack frame, false if it is malformed
+  //(no groups or fields are set then)
+  boolean parse(const char *frame, size_t len);
+  //decode the payload of a BFRAME_COMMAND frame: fields bits, then their values
+  //in the order of the bits, ints little endian
+  boolean parseBinary(const uint8_t *payload, size_t len);
+  //take the fields of the objects in mask from a newer command, e.g. to keep
+  //only the latest action of several frames
+  void merge(const BoxzCommand &newer, uint8_t mask);
+};
+
+#endif
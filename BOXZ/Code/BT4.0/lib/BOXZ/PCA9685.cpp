@@ -0,0 +1,242 @@
+/*
+PCA9685.cpp - 16 channel I2C PWM/servo driver for BOXZ.
+ Created for BOXZ MAX, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+ */
+
+/*Define
+
+ - TWI transaction queue
+ Every transaction is stored as |len|SLA+W|register|data...| where len counts the bytes after it.
+ update() and writeReg() copy a whole transaction into the queue and start the bus if it is idle.
+ The TWI interrupt sends byte by byte, at the end of a transaction it sends STOP and START
+ for the next one, at the end of the queue it sends STOP and the bus is idle again.
+ A NACK or bus error drops the transaction and counts an error; update() sends all
+ channels again after an error.
+
+ - Channel burst
+ LEDn_ON_L, LEDn_ON_H, LEDn_OFF_L, LEDn_OFF_H for each channel from the first to the last
+ changed one, registers auto increment. 66 bytes for all 16 channels.
+ */
+#include "BOXZ.h"
+
+#if BOXZ_PCA9685
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+#define TWI_MASK		(PCA9685_QUEUE - 1) // queue size is power of 2
+#define TWI_WAIT		10  // ms, begin() waits for the queue
+
+static volatile uint8_t twiQueue[PCA9685_QUEUE];
+static volatile uint8_t twiHead = 0;  // end of committed transactions
+static volatile uint8_t twiTail = 0;  // start of transaction on the bus
+static volatile uint8_t twiPos = 0;   // bytes sent of transaction on the bus
+static volatile boolean twiBusy = false;
+static volatile unsigned int twiErrors = 0;
+static uint8_t twiWr;  // write index of transaction being built
+
+/************ static functions of TWI queue ***********************/
+
+//drop the transaction on the bus and go on with the next one
+static inline void twiNext()
+{
+  twiTail = (twiTail + 1 + twiQueue[twiTail]) & TWI_MASK;
+  if(twiTail != twiHead)
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTO) | _BV(TWSTA); // STOP, then START
+  else{
+    TWCR = _BV(TWEN) | _BV(TWINT) | _BV(TWSTO);
+    twiBusy = false;
+  }
+}
+
+ISR(TWI_vect)
+{
+  switch(TW_STATUS){
+  case TW_START:
+  case TW_REP_START:
+    twiPos = 0;
+    //fall through, send SLA+W
+  case TW_MT_SLA_ACK:
+  case TW_MT_DATA_ACK:
+    if(twiPos < twiQueue[twiTail]){
+      TWDR = twiQueue[(twiTail + 1 + twiPos) & TWI_MASK];
+      twiPos++;
+      TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT);
+    }
+    else{
+      twiNext();
+    }
+    break;
+  default: //NACK, arbitration lost or bus error
+    twiErrors++;
+    twiNext();
+    break;
+  }
+}
+
+//reserve len bytes(SLA+W, register and data) for a new transaction
+static boolean twiOpen(uint8_t len)
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  uint8_t space = (twiTail - twiHead - 1) & TWI_MASK;
+  SREG = oldSREG;
+  if(space < len + 1) return false;
+  twiWr = twiHead;
+  twiQueue[twiWr] = len;
+  twiWr = (twiWr + 1) & TWI_MASK;
+  return true;
+}
+
+static inline void twiPut(uint8_t data)
+{
+  twiQueue[twiWr] = data;
+  twiWr = (twiWr + 1) & TWI_MASK;
+}
+
+//make the transaction visible to the interrupt and start the bus if idle
+static void twiCommit()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  twiHead = twiWr;
+  if(!twiBusy){
+    twiBusy = true;
+    TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWINT) | _BV(TWSTA);
+  }
+  SREG = oldSREG;
+}
+
+static unsigned int twiErrorCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned int count = twiErrors;
+  SREG = oldSREG;
+  return count;
+}
+
+/****************** end of static functions ******************************/
+
+PCA9685::PCA9685()
+{
+  _addr = PCA9685_ADDR;
+  _dirty = 0;
+  _errors = 0;
+}
+
+boolean PCA9685::begin()
+{
+  return begin(PCA9685_ADDR, PCA9685_FREQ);
+}
+
+boolean PCA9685::begin(uint8_t addr, int freq)
+{
+  _addr = addr;
+  _freq = constrain(freq, 24, 244);
+  _usScale = usScale(_freq);
+  //TWI prescaler 1
+  TWSR = 0;
+  TWBR = ((F_CPU / PCA9685_TWI_FREQ) - 16) / 2;
+  TWCR = _BV(TWEN);
+  _errors = twiErrorCount();
+
+  uint8_t prescale = (25000000UL + 2048UL * _freq) / (4096UL * _freq) - 1; //internal 25MHz oscillator
+  writeReg(PCA9685_MODE1, PCA9685_SLEEP | PCA9685_AI); //prescale can only be set in sleep
+  writeReg(PCA9685_PRESCALE, prescale);
+  writeReg(PCA9685_MODE1, PCA9685_AI);
+  unsigned long start = millis();
+  while(busy() && millis() - start < TWI_WAIT);
+  delayMicroseconds(500); //oscillator start up
+  writeReg(PCA9685_MODE1, PCA9685_RESTART | PCA9685_AI);
+  start = millis();
+  while(busy() && millis() - start < TWI_WAIT);
+
+  for(uint8_t channel = 0; channel < PCA9685_CHANNELS; channel++) _off[channel] = PCA9685_FULL;
+  _dirty = 0xFFFF;
+  boolean ok = !busy() && twiErrorCount() == _errors;
+  _errors = twiErrorCount();
+  return ok;
+}
+
+boolean PCA9685::writeReg(uint8_t reg, uint8_t value)
+{
+  if(!twiOpen(3)) return false;
+  twiPut(_addr << 1);
+  twiPut(reg);
+  twiPut(value);
+  twiCommit();
+  return true;
+}
+
+void PCA9685::set(uint8_t channel, uint16_t count)
+{
+  if(channel >= PCA9685_CHANNELS || _off[channel] == count) return;
+  _off[channel] = count;
+  _dirty |= 1 << channel;
+}
+
+void PCA9685::setPulse(uint8_t channel, int us)
+{
+  if(us < 0) us = 0;
+  set(channel, min(usToCount(us, _usScale), (uint16_t)4095));
+}
+
+void PCA9685::setPWM(uint8_t channel, int value)
+{
+  if(value <= 0) off(channel);
+  else set(channel, min(value, 4095));
+}
+
+//the count stays with the full off bit, pulse() still knows the last pulse
+void PCA9685::off(uint8_t channel)
+{
+  if(channel >= PCA9685_CHANNELS) return;
+  set(channel, _off[channel] | PCA9685_FULL);
+}
+
+int PCA9685::pulse(uint8_t channel)
+{
+  if(channel >= PCA9685_CHANNELS) return 0;
+  return countToUs(_off[channel] & (PCA9685_FULL - 1), _usScale);
+}
+
+boolean PCA9685::update()
+{
+  unsigned int errors = twiErrorCount();
+  if(errors != _errors){
+    _errors = errors;
+    _dirty = 0xFFFF; //lost burst, refresh all channels
+  }
+  if(_dirty == 0) return true;
+  uint8_t first = 0;
+  uint8_t last = PCA9685_CHANNELS - 1;
+  while(!(_dirty & (1 << first))) first++;
+  while(!(_dirty & (1 << last))) last--;
+  if(!twiOpen(2 + 4*(last - first + 1))) return false; //queue full, send next time
+  twiPut(_addr << 1);
+  twiPut(PCA9685_LED0 + 4*first);
+  for(uint8_t channel = first; channel <= last; channel++){
+    twiPut(0); //ON count
+    twiPut(0);
+    twiPut(lowByte(_off[channel]));
+    twiPut(highByte(_off[channel]));
+  }
+  twiCommit();
+  _dirty = 0;
+  return true;
+}
+
+boolean PCA9685::busy()
+{
+  return twiBusy;
+}
+
+unsigned int PCA9685::errors()
+{
+  return twiErrorCount();
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+PCA9685.h - 16 channel I2C PWM/servo driver for BOXZ.
+ Created for BOXZ MAX, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ The chip generates all pulses itself, the MCU only sends new values.
+ Values are written to a shadow copy first, update() sends all changed channels
+ in one auto increment burst. The TWI(I2C) bus is driven by its interrupt from a
+ small transaction queue, so no function waits for the bus except begin().
+
+ The TWI interrupt is owned by this driver, do not use it with the Wire library.
+ It is only compiled when BOXZ_PCA9685 is 1 in BOXZ.h.
+
+ The methods are:
+
+ begin()      - Set up TWI and the chip, default address 0x40 and 50Hz servo frame.
+ setPulse()   - Set servo pulse of a channel in microseconds.
+ setPWM()     - Set duty of a channel from 0 to 4095, for LED.
+ off()        - Channel full off, servo is not pulsed any more.
+ pulse()      - Last pulse of a channel in microseconds, also while it is off.
+ update()     - Queue one burst with all changed channels, call it every loop.
+ busy()       - Returns true while the TWI queue is not empty.
+ errors()     - Number of failed TWI transactions, failed channels are sent again.
+ usScale()    - Counts per us * 65536 at a frequency, static.
+ usToCount()  - Pulse in us to counts of a usScale(), static.
+ countToUs()  - Counts to pulse in us of a usScale(), static.
+ */
+
+#ifndef __PCA9685_H__
+#define __PCA9685_H__
+
+#if defined(ARDUINO) && ARDUINO >= 100
+#include <Arduino.h>
+#else
+#include <WProgram.h>
+#endif
+
+#define PCA9685_ADDR		0x40	// default I2C address
+#define PCA9685_CHANNELS	16
+#define PCA9685_FREQ		50		// servo frame 20ms
+#define PCA9685_TWI_FREQ	400000L	// I2C fast mode
+#define PCA9685_QUEUE		128		// bytes of TWI transaction queue, power of 2
+
+//registers
+#define PCA9685_MODE1		0x00
+#define PCA9685_MODE2		0x01
+#define PCA9685_LED0		0x06	// LED0_ON_L, 4 registers per channel
+#define PCA9685_PRESCALE	0xFE
+
+#define PCA9685_RESTART		0x80
+#define PCA9685_AI			0x20	// register auto increment
+#define PCA9685_SLEEP		0x10
+#define PCA9685_FULL		0x1000	// full on/off bit of ON/OFF count
+
+class PCA9685
+{
+public:
+  PCA9685();
+  boolean begin();
+  boolean begin(uint8_t addr, int freq);
+  void setPulse(uint8_t channel, int us);
+  void setPWM(uint8_t channel, int value);
+  void off(uint8_t channel);
+  int pulse(uint8_t channel);
+  boolean update();
+  boolean busy();
+  unsigned int errors();
+  //32 bit math as on the AVR, also on a host
+  static uint16_t usScale(uint16_t freq) //4096 * 65536 / 1000000 = 268.435 per Hz
+    { return ((uint32_t)freq * (uint32_t)268435UL + (uint32_t)500) / (uint32_t)1000; }
+  static uint16_t usToCount(uint16_t us, uint16_t scale)
+    { return ((uint32_t)us * scale) >> 16; }
+  static uint16_t countToUs(uint16_t count, uint16_t scale)
+    { return ((uint32_t)count << 16) / scale; }
+
+private:
+  uint8_t _addr;
+  uint16_t _freq;
+  uint16_t _usScale; //counts per us * 65536
+  uint16_t _off[PCA9685_CHANNELS]; //OFF count of every channel with full off bit, ON count is always 0
+  uint16_t _dirty; //changed channels
+  unsigned int _errors; //failed transactions seen by update()
+  void set(uint8_t channel, uint16_t count);
+  boolean writeReg(uint8_t reg, uint8_t value);
+};
+
+#endif
@@ -39,6 +39,7 @@
  readMicroseconds()   - Gets the last written servo pulse width in microseconds. (was read_us() in first release)
  attached()  - Returns true if there is a servo attached. 
  detach()    - Stops an attached servos from pulsing its i/o pin. 
+ isrCount()  - Returns the number of servo timer interrupts serviced so far.
  
 */
 
@@ -59,6 +60,7 @@ static servo_t servos[MAX_SERVOS];                          // static array of s
 static volatile int8_t Channel[_Nbr_16timers ];             // counter for the servo being pulsed for each timer (or -1 if refresh interval)
 
 uint8_t ServoCount = 0;                                     // the total number of attached servos
+static volatile unsigned long ServoISRCount = 0;            // number of timer interrupts serviced, for load measurement
 
 
 // convenience macros
@@ -74,6 +76,7 @@ uint8_t ServoCount = 0;                                     // the total number
 
 static inline void handle_interrupts(timer16_Sequence_t timer, volatile uint16_t *TCNTn, volatile uint16_t* OCRnA)
 {
+  ServoISRCount++;
   if( Channel[timer] < 0 )
     *TCNTn = 0; // channel set to -1 indicated that refresh interval completed so reset the timer 
   else{
@@ -225,7 +228,35 @@ static void finISR(timer16_Sequence_t timer)
     timerDetach(TIMER3OUTCOMPAREA_INT);
   }
 #else
-    //For arduino - in future: call here to a currently undefined function to reset the timer
+    //For arduino - disable the output compare interrupt so an idle timer costs no ISR time
+#if defined (_useTimer1)
+  if(timer == _timer1) {
+#if defined(__AVR_ATmega8__)|| defined(__AVR_ATmega128__)
+    TIMSK &= ~_BV(OCIE1A);   // disable timer 1 output compare interrupt
+#else
+    TIMSK1 &= ~_BV(OCIE1A);  // disable timer 1 output compare interrupt
+#endif
+  }
+#endif
+#if defined (_useTimer3)
+  if(timer == _timer3) {
+#if defined(__AVR_ATmega128__)
+    ETIMSK &= ~_BV(OCIE3A);  // disable timer 3 output compare interrupt
+#else
+    TIMSK3 &= ~_BV(OCIE3A);  // disable timer 3 output compare interrupt
+#endif
+  }
+#endif
+#if defined (_useTimer4)
+  if(timer == _timer4) {
+    TIMSK4 &= ~_BV(OCIE4A);  // disable timer 4 output compare interrupt
+  }
+#endif
+#if defined (_useTimer5)
+  if(timer == _timer5) {
+    TIMSK5 &= ~_BV(OCIE5A);  // disable timer 5 output compare interrupt
+  }
+#endif
 #endif
 }
 
@@ -276,7 +307,11 @@ uint8_t Servo::attach(int pin, int min, int max)
 
 void Servo::detach()  
 {
+  uint8_t oldSREG = SREG;
+  cli();
   servos[this->servoIndex].Pin.isActive = false;  
+  digitalWrite(servos[this->servoIndex].Pin.nbr, LOW); // the ISR skips inactive pins, so do not leave a pulse high
+  SREG = oldSREG;
   timer16_Sequence_t timer = SERVO_INDEX_TO_TIMER(servoIndex);
   if(isTimerActive(timer) == false) {
     finISR(timer);
@@ -335,3 +370,12 @@ bool Servo::attached()
 {
   return servos[this->servoIndex].Pin.isActive ;
 }
+
+unsigned long Servo::isrCount()
+{
+  uint8_t oldSREG = SREG;
+  cli();
+  unsigned long count = ServoISRCount;
+  SREG = oldSREG;
+  return count;
+}
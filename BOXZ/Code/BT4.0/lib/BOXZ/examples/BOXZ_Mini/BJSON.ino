@@ -11,38 +11,67 @@ void initJSON()
   watchDogEn = false;
   watchDogTimerEn = false;
   watchDogTimer = millis();
+  binaryLink = false; //JSON until the app asks for frames again(ME 5)
   //Serial.println("Init...."); 
 }
+
 //*******************************************************************
 //deal with Serial data input, include watch dog function
+//all commands waiting are read, CF right away, AT only the latest one
 void serialDataInput() 
 {
-  watchDogJSON(); 
-
-  if (serial_stream.available()) {
-    /* First, skip any accidental whitespace like newlines. */
-    serial_stream.skip();
+  BoxzCommand action; //AT fields of all commands read, newer ones win
+  action.groups = 0;
+  action.fields = 0;
+  int frames = 0;
+
+  if (binaryLink) {
+    //frames with bad CRC are dropped, the next good one is still read
+    while (frames < drainLimit && serial_frame.collect(&Serial) == BFRAME_READY) {
+      BoxzCommand cmd;
+      if (serial_frame.type() == BFRAME_COMMAND && cmd.parseBinary(serial_frame.payload(), serial_frame.length()))
+        drainCommand(cmd, action);
+      frames ++;
+    }
+  }
+  else {
+    watchDogJSON(); 
+    //stop at ME 5, the next bytes are frames
+    while (frames < drainLimit && !binaryLink && serial_stream.available()) {
+      //JSON or MessagePack, decoded straight from the frame buffer
+      BoxzCommand cmd;
+      boolean good = cmd.parse(serialFrame, serial_stream.length());
+      serial_stream.reset(); //done with this frame
+      watchDogCount ++; //a broken frame only counts here
+      if (good) drainCommand(cmd, action);
+      frames ++;
+    }
   }
 
-  if (serial_stream.available()) {
-    /* Something real on input, let's take a look. */
-    aJsonObject *msg = aJson.parse(&serial_stream);
-    ComExecution(msg);
+  if (frames > 0) {
+    ComExecution(action);
     //motorCom(valueK1); //20140830 change place to here.
     //motorComSP(valueK1,valueV1,valueV2,testmode);
-    aJson.deleteItem(msg);
-    watchDogCount ++;
     serialDataDone= true;
   }
 }
 
+//execute CF of a command, keep its AT for the end of serialDataInput()
+void drainCommand(BoxzCommand &cmd, BoxzCommand &action)
+{
+  if (action.groups & cmd.groups & BOXZ_AT) coalescedFrames ++;
+  action.merge(cmd, BOXZ_AT);
+  cmd.groups &= ~BOXZ_AT;
+  ComExecution(cmd);
+}
+
 //deal with unknown format data
 void watchDogJSON()
 {
   if(watchDogCount > watchDogCountLimit){
     //Serial.println(F("{\"PT\":{\"ME\":3}}")); //Watch Dog Enable! //2014.09.02 delete by Leo
     valueME = 3;        //2014.09.02 add by Leo
-    bitSet(valueVB,7);  //2014.09.02 add by Leo
+    telemetry.touch(TM_ME);  //2014.09.02 add by Leo
     watchDogEn = true;
   }
 
@@ -55,56 +84,29 @@ void watchDogJSON()
   }
 }
 
-//deal with JSON data input
-void ComExecution(aJsonObject *msg)
+//deal with command input
+//range checks are in tools/boxz_command.txt, fields that are missing or out of range are not set
+void ComExecution(const BoxzCommand &cmd)
 {
   //Example
   //{"CF":{"ME:1}}           IOS          
   //{"CF":{"HP":100}}        IOS 
-  aJsonObject *config = aJson.getObjectItem(msg, "CF"); //property
-  if (config) {
-    aJsonObject *config_ME = aJson.getObjectItem(config, "ME");  //Message
-    aJsonObject *config_HP = aJson.getObjectItem(config, "HP");  //HP
-    aJsonObject *config_MP = aJson.getObjectItem(config, "MP");  //MP
-    //Sample: config_HP->valueint;//HPtoINT
-    //Sample: config_HP->valuestring);//toString
-    int valueHPBuf = config_HP->valueint;
-    int valueMPBuf = config_MP->valueint;
-    if(valueHPBuf>=1&&valueHPBuf<=255) valueHP=valueHPBuf;
-    if(valueMPBuf>=1&&valueMPBuf<=255) valueMP=valueMPBuf; 
-    //valueHP = valueByteChecking(config_HP->valueint);
-    //valueMP = valueByteChecking(config_MP->valueint);
-
+  if (cmd.groups & BOXZ_CF) { //property
+    if (cmd.fields & BOXZ_CF_HP) valueHP = cmd.hp;
+    if (cmd.fields & BOXZ_CF_MP) valueMP = cmd.mp;
     //setHealth(config_HP->valueint);//2014.09.02 add by orge_c
     //setMagic(config_MP->valueint);//2014.09.22 add by Leo
-    processME(config_ME->valueint); //2014.09.02 add by orge_c
+    if (cmd.fields & BOXZ_CF_ME) processME(cmd.me); //2014.09.02 add by orge_c
     watchDogCount = 0;
   }
   //{"AT":{"K1":"w"}}
   //{"AT":{"K2":"u"}}
-  aJsonObject *action = aJson.getObjectItem(msg, "AT");
-  if(action) { 
-    aJsonObject *action_V1 = aJson.getObjectItem(action, "V1"); 
-    aJsonObject *action_V2 = aJson.getObjectItem(action, "V2"); 
-    aJsonObject *action_K1 = aJson.getObjectItem(action, "K1"); //key1: Direction control
-    aJsonObject *action_K2 = aJson.getObjectItem(action, "K2"); //key2: button and skill
-
-    //just for current version start
-    String key1s = action_K1->valuestring;
-    String key2s = action_K2->valuestring;
-    int valueK1Buf = key1s.charAt(0);
-    int valueK2Buf = key2s.charAt(0);
-
-    //valueK1=valueByteChecking(key1Buf);
-    //valueK2=valueByteChecking(key2Buf); 
-    int valueV1Buf = action_V1->valueint;
-    int valueV2Buf = action_V2->valueint;
-    if(valueV1Buf>=50&&valueV1Buf<=255) valueV1=valueV1Buf; //here is a bug if > 1, maybe get unknown value ?3/?7
-    if(valueV2Buf>=50&&valueV2Buf<=255) valueV2=valueV2Buf; //also the speed could not reach too low.
-    if(valueK1Buf>=1&&valueK1Buf<=255) valueK1=valueK1Buf;
-    if(valueK2Buf>=1&&valueK2Buf<=255) valueK2=valueK2Buf; 
-    //valueV1 = valueByteChecking(action_V1->valueint);  
-    //valueV2 = valueByteChecking(action_V2->valueint); 
+  if (cmd.groups & BOXZ_AT) { 
+    //V1, V2 from 50, the speed could not reach too low.
+    if (cmd.fields & BOXZ_AT_V1) valueV1 = cmd.v1;
+    if (cmd.fields & BOXZ_AT_V2) valueV2 = cmd.v2;
+    if (cmd.fields & BOXZ_AT_K1) valueK1 = (uint8_t) cmd.k1; //key1: Direction control
+    if (cmd.fields & BOXZ_AT_K2) valueK2 = (uint8_t) cmd.k2; //key2: button and skill
     watchDogCount = 0;
   }
 }
@@ -114,53 +116,49 @@ void ComExecution(aJsonObject *msg)
 //Output data for serial data
 void serialDataOutput()
 {
-  if (valueVB > 0) {
-    aJsonObject *msg = createMessage();
-    aJson.print(msg, &serial_stream);
-    Serial.println(); /* Add newline. */
-    aJson.deleteItem(msg);
-    valueME = 0; //2014.09.02 add by Leo
+  unsigned long now = millis();
+  if (binaryLink) {
+    uint8_t report[BFRAME_PAYLOAD];
+    uint8_t len = createReport(report, now);
+    if (len > 0) BFrame::send(&Serial, BFRAME_REPORT, frameSeq++, report, len);
   }
+  else {
+    aJsonWriter msg(outputFrame, sizeof(outputFrame));
+    if (createMessage(msg, now)) msg.send(&Serial); //whole message with newline in one write
+  }
+}
+
+/* Same as createMessage() for a BFRAME_REPORT frame: |id|value low|value high| of every
+   field that is due, ids are TM_*, returns the payload length */
+uint8_t createReport(uint8_t *report, unsigned long now)
+{
+  uint8_t len = 0;
+  for (int id = telemetry.first(now); id != EOF && len + 3 <= BFRAME_PAYLOAD; id = telemetry.next(now, id)) {
+    int value = telemetry.value(id);
+    report[len++] = id;
+    report[len++] = lowByte(value);
+    report[len++] = highByte(value);
+    telemetry.sent(id, now);
+  }
+  return len;
 }
 
 /* Generate message like: {"PT":{"HP":100, "MP":100}} */
 //not public version, include information of next version
-//1. valueVB
-//2. PT -> ME -> ID
-aJsonObject *createMessage()
+//1. PT -> ME -> ID
+//fields that are due from telemetry, false if there is none
+boolean createMessage(aJsonWriter &msg, unsigned long now)
 {
   //{"PT":{"HP":100}}        Arduino
   //{"PT":{"ME":1264}}       Arduino
-  aJsonObject *msg,*propty;
-  msg = aJson.createObject(); 
-  aJson.addItemToObject(msg, "PT", propty = aJson.createObject());
-  if(bitRead(valueVB,0) == 1) 
-  {
-    aJson.addNumberToObject(propty ,"V2", valueV2);
-    bitClear(valueVB,0); //2014.09.22 add by Leo
-  }
-  if(bitRead(valueVB,1) == 1) 
-  {
-    aJson.addNumberToObject(propty ,"V1", valueV1);
-    bitClear(valueVB,1); //2014.09.22 add by Leo
-  }
-  if(bitRead(valueVB,2) == 1) 
-  {
-    aJson.addNumberToObject(propty ,"MP", valueMP);
-    bitClear(valueVB,2); //2014.09.22 add by Leo
-  }
-  if(bitRead(valueVB,3) == 1) 
-  {
-    aJson.addNumberToObject(propty ,"HP", valueHP);
-    bitClear(valueVB,3); //2014.09.02 add by orge_c
-  }
-  if(bitRead(valueVB,7) == 1) 
-  {
-    aJson.addNumberToObject(propty ,"ME", valueME);
-    bitClear(valueVB,7); //2014.09.02 add by orge_c
-  }
-
-  return msg;
+  msg.beginObject();
+  msg.key(F("PT"));
+  msg.beginObject();
+  //what fits before "}}" and the newline
+  unsigned char count = telemetry.write(&msg, now, sizeof(outputFrame) - msg.length() - 4);
+  msg.endObject();
+  msg.endObject();
+  return count > 0;
 }
 
 
@@ -175,25 +173,21 @@ void testFunction(int _mode)//2014.09.02 add by orge_c
     case 'u':
       {
         valueHP -= 15; 
-        bitSet(valueVB,3); 
         break;
       } 
     case 'i':
       {   
         valueHP += 15;
-        bitSet(valueVB,3); 
         break;
       } 
     case 'j':
       {   
         valueMP -= 15; 
-        bitSet(valueVB,2); 
         break;
       } 
     case 'k':
       {   
         valueMP += 15;
-        bitSet(valueVB,2); 
         break;
       } 
     default: 
@@ -212,28 +206,24 @@ void testFunction(int _mode)//2014.09.02 add by orge_c
       {
         valueHP -= 15; 
         valueV1 = valueHP;
-        bitSet(valueVB,3); 
         break;
       } 
     case 'i':
       {   
         valueHP += 15;
         valueV1 = valueHP;
-        bitSet(valueVB,3); 
         break;
       } 
     case 'j':
       {   
         valueMP -= 15; 
         valueV2 = valueMP;
-        bitSet(valueVB,2); 
         break;
       } 
     case 'k':
       {   
         valueMP += 15;
         valueV2 = valueMP;
-        bitSet(valueVB,2); 
         break;
       } 
     default: 
@@ -267,7 +257,7 @@ void processME(int reqNo)
       EEPROM.write(addressID, boxzIDValue);
       valueME = boxzIDValue; //add 2014.08.30
       boxzIDChecked = true;  
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
 
       break;
     }
@@ -275,7 +265,7 @@ void processME(int reqNo)
     {
       watchDogTimerEn = true; //set 1 when receive heartbeat
       valueME = 2; 
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
       //serialDataDone = false; //disable test output
       break;
     } 
@@ -287,7 +277,21 @@ void processME(int reqNo)
   case 0x04://RAM
     {   
       valueME = freeMem(&biggest);
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
+      break;
+    }  
+  case 0x05://binary frames, this answer is the first BFrame
+    {   
+      binaryLink = true;
+      serial_frame.reset();
+      valueME = 5;
+      telemetry.touch(TM_ME); 
+      break;
+    }  
+  case 0x06://AT commands skipped for a newer one
+    {   
+      valueME = coalescedFrames;
+      telemetry.touch(TM_ME); 
       break;
     }  
 
@@ -301,7 +305,7 @@ void processME(int reqNo)
     {   
       testmode = 1;
       valueME = 0xC1;
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
       break;
     } 
 
@@ -309,7 +313,7 @@ void processME(int reqNo)
     {   
       testmode = 2; 
       valueME = 0xC2;
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
       break;
     } 
 
@@ -317,7 +321,7 @@ void processME(int reqNo)
     {   
       testmode = 3; 
       valueME = 0xC3;
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
       break;
     } 
   default: 
@@ -340,7 +344,7 @@ void heartbeat()
       //watchDogTimer = millis();
       //stop();
       valueME = 9; 
-      bitSet(valueVB,7); 
+      telemetry.touch(TM_ME); 
     } 
 
     //||(valueK1 + valueK2 > 0x60) bug
@@ -359,16 +363,7 @@ void valueCheck()
   if(valueMP<=1) valueMP = 1;
   if(valueHP>=255) valueHP = 255;
   if(valueMP>=255) valueMP = 255;
-
-  //Update output VB when HP and MP value changed
-  if(valueHPtemp != valueHP){
-    bitSet(valueVB,3);
-    valueHPtemp = valueHP;
-  }
-  if(valueMPtemp != valueMP){
-    bitSet(valueVB,2);
-    valueMPtemp = valueMP;
-  }
+  //changes of HP and MP are sent by telemetry
 }
 
 
@@ -17,6 +17,22 @@
 #include <BOXZ.h>
 
 
+//2026.10.18
+//1. release servo after resting, servoIdle() and servoUpdate()
+//2. serial input collected by aJsonFrameStream, loop() never waits for a JSON message
+//3. JSON objects allocated from jsonArena, no heap fragmentation
+//4. ComExecution() looks up keys by hash, jsonItem()
+//5. parse only the fields ComExecution() uses, jsonFilter
+//6. output message written by aJsonWriter, no objects and a single write
+//7. commands can be sent as MessagePack too, one BLE packet instead of three
+//8. commands decoded by BoxzCommand(generated from tools/boxz_command.txt), no aJson objects,
+//   missing fields are ignored, a malformed command is dropped whole
+//9. binary frames with CRC(BFrame) after the app sent ME 5, a broken frame costs only itself
+//10. output values registered in aJsonTelemetry instead of valueVB, sent when changed,
+//    HP and MP at most every 100ms, one message per loop
+//11. all waiting commands are read in one loop, only the latest AT is executed(coalescedFrames),
+//    ME 6 reports how many were skipped
+
 //2014.11.04
 //1. add BOXZ.h new lib include motor and servo support
 //2. separate function into separate file
@@ -56,7 +72,14 @@
 //Fixed watchDog for ROMEO with Leonardo, not support serialEvent.
 
 
-aJsonStream serial_stream(&Serial);
+char serialFrame[96]; //longest JSON message we accept
+aJsonFrameStream serial_stream(&Serial, serialFrame, sizeof(serialFrame));
+char outputFrame[64]; //output message, {"PT":{...}} with all fields fits
+BFrame serial_frame; //binary frames with CRC, used after ME 5
+boolean binaryLink = false; //true: BFrame, false: JSON
+uint8_t frameSeq = 0; //sequence number of our frames
+int drainLimit = 8; //commands read per loop at most
+unsigned int coalescedFrames = 0; //AT commands replaced by a newer one before they were executed
 
 //Serial speed config
 //unsigned long serialSpeed = 115200; //9600 for HC
@@ -79,7 +102,6 @@ int pinSoftSerial = 8;
 int valueME; //Message
 int valueHP; //Health para
 int valueMP; //Magic para
-int valueVB; //Visu Byte
 
 
 // - AT:Action
@@ -88,9 +110,14 @@ int valueK2; //Button key 2 for function key A/B/C/D
 int valueV1; //motor speed left
 int valueV2; //motor speed right
 
-//temp Value
-int valueHPtemp; //Health para
-int valueMPtemp; //Magic para
+//output values, ids in the order they are added in setup(), also the ids of BFRAME_REPORT
+#define TM_V2 0
+#define TM_V1 1
+#define TM_MP 2
+#define TM_HP 3
+#define TM_ME 4
+aJsonTelemetryField telemetryFields[5];
+aJsonTelemetry telemetry(telemetryFields, 5);
 
 //for JSON
 boolean watchDogEn;
@@ -111,6 +138,7 @@ void setup()
 {
   boxz.initMotor();
   boxz.initServo();
+  boxz.servoIdle(2000); //release servo after 2s at rest
   Serial.begin(serialSpeed);
   initJSON();
 
@@ -121,6 +149,12 @@ void setup()
   valueV2 = 0xFF;
   valueHP = 0xFF;
   valueMP = 0xFF;
+
+  telemetry.addEvent("V2", &valueV2); //not sent yet
+  telemetry.addEvent("V1", &valueV1);
+  telemetry.add("MP", &valueMP, 100, 0); //when changed, test modes can not flood the link
+  telemetry.add("HP", &valueHP, 100, 0);
+  telemetry.addEvent("ME", &valueME); //answers, telemetry.touch(TM_ME)
 }
 
 
@@ -136,6 +170,7 @@ void loop()
     boxz.motorCom(valueK1,valueV1,valueV2); //2014.09.26 updata to here. 
     boxz.servoCom(valueK2);
   }
+  boxz.servoUpdate();
 
   //process data every loop cycle
   heartbeat();//2014.09.02 add by orge_c
@@ -18,6 +18,30 @@
 #include <BOXZ.h>
 
 
+//2026.10.18
+//1. release servo after resting, servoIdle() and servoUpdate()
+//2. serial input collected by aJsonFrameStream, loop() never waits for a JSON message
+//3. JSON objects allocated from jsonArena, no heap fragmentation
+//4. ComExecution() looks up keys by hash, jsonItem()
+//5. parse only the fields ComExecution() uses, jsonFilter
+//6. output message written by aJsonWriter, no objects and a single write
+//7. commands can be sent as MessagePack too, one BLE packet instead of three
+//8. commands decoded by BoxzCommand(generated from tools/boxz_command.txt), no aJson objects,
+//   missing fields are ignored, a malformed command is dropped whole
+//9. binary frames with CRC(BFrame) after the app sent ME 5, a broken frame costs only itself
+//10. output values registered in aJsonTelemetry instead of valueVB, sent when changed,
+//    HP and MP at most every 100ms, one message per loop
+//11. all waiting commands are read in one loop, only the latest AT is executed(coalescedFrames),
+//    ME 6 reports how many were skipped
+//12. BOXZ_SERIAL 1 in BOXZ.h receives the BLE link into the 256 byte ring of bserial(BLE_SERIAL),
+//    ME 7 reports bytes lost because the ring was full
+//13. loop() runs the tasks of BTask at their own period, input 2ms, commands 5ms,
+//    heartbeat 10ms, servo idle and output 20ms, ME 8 reports missed starts
+//14. BOXZ_PROFILE 1 in BOXZ.h measures input, motorCom, servoCom and output(PF_*),
+//    ME 16 + stage sends min/avg/max and histogram of a stage({"PF":...} or BFRAME_PROFILE)
+//15. ME 256 + tag is a round trip probe, answered right after motorCom() with micros() of
+//    receive, motorCom() and send({"EC":...} or BFRAME_ECHO), see tools/boxz_latency.py
+
 //2014.11.10
 //1. add servo support
 
@@ -60,7 +84,20 @@
 //Fixed watchDog for ROMEO with Leonardo, not support serialEvent.
 
 
-aJsonStream serial_stream(&Serial1);
+#if BOXZ_SERIAL
+#define BLE_SERIAL bserial //Serial1 received by BSerial, no bytes lost during servo moves
+#else
+#define BLE_SERIAL Serial1
+#endif
+
+char serialFrame[96]; //longest JSON message we accept
+aJsonFrameStream serial_stream(&BLE_SERIAL, serialFrame, sizeof(serialFrame));
+char outputFrame[64]; //output message, {"PT":{...}} with all fields fits
+BFrame serial_frame; //binary frames with CRC, used after ME 5
+boolean binaryLink = false; //true: BFrame, false: JSON
+uint8_t frameSeq = 0; //sequence number of our frames
+int drainLimit = 8; //commands read per loop at most
+unsigned int coalescedFrames = 0; //AT commands replaced by a newer one before they were executed
 
 //Serial speed config
 //unsigned long serialSpeed = 115200; //9600 for HC
@@ -83,7 +120,6 @@ int pinSoftSerial = 8;
 int valueME; //Message
 int valueHP; //Health para
 int valueMP; //Magic para
-int valueVB; //Visu Byte
 
 
 // - AT:Action
@@ -92,9 +128,14 @@ int valueK2; //Button key 2 for function key A/B/C/D
 int valueV1; //motor speed left
 int valueV2; //motor speed right
 
-//temp Value
-int valueHPtemp; //Health para
-int valueMPtemp; //Magic para
+//output values, ids in the order they are added in setup(), also the ids of BFRAME_REPORT
+#define TM_V2 0
+#define TM_V1 1
+#define TM_MP 2
+#define TM_HP 3
+#define TM_ME 4
+aJsonTelemetryField telemetryFields[5];
+aJsonTelemetry telemetry(telemetryFields, 5);
 
 //for JSON
 boolean watchDogEn;
@@ -109,13 +150,29 @@ static unsigned long watchDogLimit = 5000;
 //System RAM
 uint16_t biggest;
 
+//tasks of loop(), period in us, priority 0 first
+BTask scheduler;
+
+//stages of bprofile, BOXZ_PROBE() is empty without BOXZ_PROFILE
+#define PF_INPUT 0
+#define PF_MOTOR 1
+#define PF_SERVO 2
+#define PF_OUTPUT 3
+int profileStage = -1; //stage asked by ME 16 + stage, sent with the next output
+
+//round trip probe, ME 256 + tag
+int echoTag = -1; //tag of the probe not answered yet
+unsigned long echoReceived; //micros() of the probe in processME()
+unsigned long echoMotor; //micros() of motorCom() after it
+
 
 
 void setup()
 {
   boxz.initMotor();
   boxz.initServo();
-  Serial1.begin(serial1Speed);
+  boxz.servoIdle(2000); //release servo after 2s at rest
+  BLE_SERIAL.begin(serial1Speed);
   initJSON();
 
   //test function. APP should send {"AT":{"V1":255}} and {"AT":{"V2":255}}   2014.09.23 add by Leo
@@ -125,35 +182,76 @@ void setup()
   valueV2 = 0xFF;
   valueHP = 0xFF;
   valueMP = 0xFF;
+
+  telemetry.addEvent("V2", &valueV2); //not sent yet
+  telemetry.addEvent("V1", &valueV1);
+  telemetry.add("MP", &valueMP, 100, 0); //when changed, test modes can not flood the link
+  telemetry.add("HP", &valueHP, 100, 0);
+  telemetry.addEvent("ME", &valueME); //answers, telemetry.touch(TM_ME)
+
+  scheduler.add(inputTask, 2000, 0); //Serial1 keeps 64 bytes, 5.5ms at 115200
+  scheduler.add(commandTask, 5000, 1);
+  scheduler.add(heartbeat, 10000, 2);
+  scheduler.add(servoTask, 20000, 3);
+  scheduler.add(outputTask, 20000, 3);
+
+#if BOXZ_PROFILE
+  bprofile.name(PF_INPUT, "IN");
+  bprofile.name(PF_MOTOR, "MO");
+  bprofile.name(PF_SERVO, "SE");
+  bprofile.name(PF_OUTPUT, "OU");
+#endif
 }
 
 
 void loop()
 {
-  //Serial data input(include watch dog function and JSON data input process)
-  //This block will update the data of BOXZ(such as HP/MP....)
+  scheduler.run();
+}
+
+//Serial data input(include watch dog function and JSON data input process)
+//This block will update the data of BOXZ(such as HP/MP....)
+void inputTask()
+{
+  BOXZ_PROBE(PF_INPUT);
   serialDataInput();
+}
 
-  //process area start
-  //process data at serial data input finished
+//process data at serial data input finished
+void commandTask()
+{
   if(serialDataDone == true){
-    boxz.motorCom(valueK1,valueV1,valueV2); //2014.09.26 updata to here. 
-    boxz.servoCom(valueK2);
+    if(echoTag >= 0) echoMotor = micros();
+    {
+      BOXZ_PROBE(PF_MOTOR);
+      boxz.motorCom(valueK1,valueV1,valueV2); //2014.09.26 updata to here. 
+    }
+    {
+      BOXZ_PROBE(PF_SERVO);
+      boxz.servoCom(valueK2);
+    }
   }
-
-  //process data every loop cycle
-  heartbeat();//2014.09.02 add by orge_c
+  //answer a probe now, not with the next output
+  if(echoTag >= 0) sendEcho();
   testFunction(testmode); //2014.09.02 add by orge_c
 
   //userdefined();
 
-  //value limit, fix the value out of range
-  valueCheck();
-  //Serial data output, send JSON data out
-  serialDataOutput();
   //Reset serial data done
   serialDataReset();
 }
 
+//detach servo at rest
+void servoTask()
+{
+  boxz.servoUpdate();
+}
 
-
+void outputTask()
+{
+  BOXZ_PROBE(PF_OUTPUT);
+  //value limit, fix the value out of range
+  valueCheck();
+  //Serial data output, send JSON data out
+  serialDataOutput();
+}
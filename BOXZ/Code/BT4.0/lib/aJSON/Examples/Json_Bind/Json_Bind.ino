@@ -0,0 +1,59 @@
+/*
+  Sample sketch parsing JSON from Serial straight into a struct
+
+  This sketch accepts per-line JSON messages like
+  { "led": { "pin": 9, "pwm": 128 }, "name": "lamp" } and binds them to
+  the members of struct Led through one table of fields. Values out of
+  range or of the wrong type are not set, keys that are not in the table
+  are skipped. The same table writes the state back as JSON.
+
+  Circuit:
+  * (Optional) LED attached to a PWM pin, e.g. 9.
+
+  https://github.com/interactive-matter/ajson
+  This code is in the public domain.
+ */
+
+#include <aJSON.h>
+
+struct Led {
+  unsigned char pin;
+  int pwm;
+  char name[8];
+};
+
+const aJsonField ledFields[] = {
+  aJson_Field(Led, pin, "led.pin", Byte, 2, 13),
+  aJson_Field(Led, pwm, "led.pwm", Int, 0, 255),
+  aJson_StringField(Led, name, "name"),
+};
+
+Led led = { 9, 0, "led" };
+
+char frame[64];
+aJsonFrameStream serial_stream(&Serial, frame, sizeof(frame));
+char output[64];
+
+void setup()
+{
+  Serial.begin(9600);
+}
+
+void loop()
+{
+  if (serial_stream.available()) {
+    /* A complete message is waiting, its values go right into led. */
+    unsigned long found;
+    if (serial_stream.bind(&led, ledFields, aJson_FieldCount(ledFields), &found) == EOF) {
+      Serial.println("invalid message");
+      return;
+    }
+    if (found) {
+      analogWrite(led.pin, led.pwm);
+    }
+    /* Answer with the fields that were set, e.g. {"led":{"pwm":128}} */
+    aJsonWriter out(output, sizeof(output));
+    out.emit(&led, ledFields, aJson_FieldCount(ledFields), found);
+    out.send(&Serial);
+  }
+}
@@ -0,0 +1,63 @@
+/*
+  Sample sketch parsing JSON from Serial without building objects
+
+  This sketch accepts the same per-line JSON messages as Json_Serial,
+  e.g. { "pwm": { "8": 0, "9": 128 } }, but reads them with
+  parseEvents(): every value is handed to a callback as soon as it is
+  read, together with its key path ("pwm.8"). No aJsonObject is created
+  and no memory is allocated.
+
+  Circuit:
+  * (Optional) LEDs attached to PWM pins 9 and 8.
+
+  https://github.com/interactive-matter/ajson
+  This code is in the public domain.
+ */
+
+#include <aJSON.h>
+
+char frame[64];
+aJsonFrameStream serial_stream(&Serial, frame, sizeof(frame));
+
+class PwmHandler : public aJsonHandler {
+public:
+  /* Called for every number, path is like "pwm.9" */
+  virtual void intValue(const char *path, int value)
+  {
+    if (strncmp(path, "pwm.", 4) != 0) return; /* Not for us, ok. */
+    int pin = atoi(path + 4);
+    if (pin != 8 && pin != 9) {
+      Serial.print("unknown pin ");
+      Serial.println(path + 4);
+      return;
+    }
+    Serial.print("setting pin ");
+    Serial.print(pin, DEC);
+    Serial.print(" to value ");
+    Serial.println(value, DEC);
+    analogWrite(pin, value);
+  }
+
+  virtual void stringValue(const char *path, const char *value)
+  {
+    Serial.print("invalid data type for ");
+    Serial.println(path);
+  }
+};
+
+PwmHandler handler;
+
+void setup()
+{
+  Serial.begin(9600);
+}
+
+void loop()
+{
+  if (serial_stream.available()) {
+    /* A complete message is waiting, the handler sees it value by value. */
+    if (serial_stream.parseEvents(&handler) == EOF) {
+      Serial.println("invalid message");
+    }
+  }
+}
@@ -20,10 +20,12 @@
 
 unsigned long last_print = 0;
 aJsonStream serial_stream(&Serial);
+char output[64]; /* One message is collected here and sent at once. */
 
 void setup()
 {
   Serial.begin(9600);
+  serial_stream.setOutputBuffer(output, sizeof(output));
 }
 
 /* Generate message like: { "analog": [0, 200, 400, 600, 800, 1000] } */
@@ -80,7 +82,7 @@ void loop()
     /* One second elapsed, send message. */
     aJsonObject *msg = createMessage();
     aJson.print(msg, &serial_stream);
-    Serial.println(); /* Add newline. */
+    serial_stream.send(); /* Add newline and write it out. */
     aJson.deleteItem(msg);
     last_print = millis();
   }
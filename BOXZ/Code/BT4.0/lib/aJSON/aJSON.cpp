@@ -32,23 +32,46 @@
  ******************************************************************************/
 
 #include <string.h>
-#include <math.h>
 #include <stdlib.h>
-#include <float.h>
+#include <limits.h>
 #include <ctype.h>
 #include <avr/pgmspace.h>
 
 #include "aJSON.h"
-#include "utility/stringbuffer.h"
 
 /******************************************************************************
  * Definitions
  ******************************************************************************/
-//Default buffer sizes - buffers get initialized and grow acc to that size
-#define BUFFER_DEFAULT_SIZE 4
-
 //how much digits after . for float
 #define FLOAT_PRECISION 5
+//0.5 / 10^FLOAT_PRECISION, rounds the last printed digit
+#define FLOAT_ROUNDING 0.000005
+
+//a number keeps as many significant digits as fit into an unsigned long (9 or more)
+#define MANTISSA_LIMIT ((ULONG_MAX - 9) / 10)
+//exponents are clipped here, far beyond what a float can hold
+#define EXPONENT_LIMIT 1000
+
+#if !aJson_IntegerOnly
+//10^1, 10^2, 10^4, ... 10^32 - any exponent below 64 is a product of these
+static const double powers_of_10[] = { 1e1, 1e2, 1e4, 1e8, 1e16, 1e32 };
+#endif
+
+//alignment of arena allocations, AVR does not need any
+#ifdef __AVR__
+#define ARENA_ALIGN 1
+#else
+#define ARENA_ALIGN sizeof(double)
+#endif
+
+//words behind the first word of an aJsonTape item
+#define TAPE_WORDS(bytes) (((bytes) + 1) / 2)
+#define TAPE_ENTRY(type, size) ((uint16_t) (type) << 12 | (size))
+
+//arena of aJsonClass::setArena(), unused if arena is NULL
+static char *arena = NULL;
+static size_t arena_size = 0;
+static size_t arena_used = 0;
 
 
 bool
@@ -56,10 +79,11 @@ aJsonStream::available()
 {
   if (bucket != EOF)
     return true;
-  while (stream()->available())
+  int ch;
+  // read() returns EOF when the stream is empty, no need to ask available()
+  while ((ch = stream()->read()) != EOF)
     {
       /* Make an effort to skip whitespace. */
-      int ch = this->getch();
       if (ch > 32)
        {
 	 this->ungetch(ch);
@@ -78,27 +102,91 @@ aJsonStream::getch()
       bucket = EOF;
       return ret;
     }
+  // Usually the char is already there, only wait if it is not.
+  int ch = stream()->read();
+  if (ch != EOF)
+    {
+      return ch;
+    }
   // In case input was malformed - can happen, this is the
   // real world, we can end up in a situation where the parser
   // would expect another character and end up stuck on
   // stream()->available() forever, hence the 500ms timeout.
   unsigned long i= millis()+500;
-  while ((!stream()->available()) && (millis() < i)) /* spin with a timeout*/;
-  return stream()->read();
+  while (((ch = stream()->read()) == EOF) && (millis() < i)) /* spin with a timeout*/;
+  return ch;
 }
 
 void
 aJsonStream::ungetch(char ch)
 {
-  bucket = ch;
+  bucket = (unsigned char) ch;
 }
 
 size_t
 aJsonStream::write(uint8_t ch)
 {
+  if (out_buffer)
+    {
+      if (out_len >= out_size)
+        {
+          writeBuffer(); // frame longer than the buffer, send this piece
+        }
+      out_buffer[out_len++] = ch;
+      return 1;
+    }
   return stream()->write(ch);
 }
 
+size_t
+aJsonStream::write(const uint8_t *buffer, size_t size)
+{
+  if (out_buffer == NULL)
+    {
+      return Print::write(buffer, size);
+    }
+  for (size_t i = 0; i < size; i++)
+    {
+      if (out_len >= out_size)
+        {
+          writeBuffer();
+        }
+      out_buffer[out_len++] = buffer[i];
+    }
+  return size;
+}
+
+void
+aJsonStream::setOutputBuffer(char *buffer, size_t size)
+{
+  if (out_buffer)
+    {
+      writeBuffer();
+    }
+  out_buffer = size ? buffer : NULL;
+  out_size = size;
+  out_len = 0;
+}
+
+size_t
+aJsonStream::writeBuffer()
+{
+  size_t written = stream()->write((const uint8_t*) out_buffer, out_len);
+  out_len = 0;
+  return written;
+}
+
+size_t
+aJsonStream::send()
+{
+  this->print("\r\n");
+  if (out_buffer == NULL)
+    {
+      return 2;
+    }
+  return writeBuffer();
+}
+
 size_t
 aJsonStream::readBytes(uint8_t *buffer, size_t len)
 {
@@ -133,6 +221,276 @@ aJsonClientStream::getch()
   return stream()->read();
 }
 
+// MessagePack types
+#define PACK_STRING(b) (((b) >= 0xa0 && (b) <= 0xbf) || ((b) >= 0xd9 && (b) <= 0xdb))
+#define PACK_FRAME(b) (((b) >= 0x80 && (b) <= 0x9f) || ((b) >= 0xdc && (b) <= 0xdf))
+
+// Decode the MessagePack header in the n bytes at p. Returns its length,
+// 0 if more bytes are needed or EOF if it is no header. size is the bytes
+// following the header, items the values following it.
+static int
+unpackHeader(const unsigned char *p, size_t n, uint32_t *size, uint32_t *items)
+{
+  if (n == 0)
+    {
+      return 0;
+    }
+  unsigned char type = p[0];
+  *size = *items = 0;
+  if (type <= 0x7f || type >= 0xe0 || type == 0xc0 || type == 0xc2
+      || type == 0xc3)
+    {
+      return 1; // fixint, nil, false, true
+    }
+  if (type <= 0x8f)
+    {
+      *items = 2 * (type & 0x0f); // fixmap
+      return 1;
+    }
+  if (type <= 0x9f)
+    {
+      *items = type & 0x0f; // fixarray
+      return 1;
+    }
+  if (type <= 0xbf)
+    {
+      *size = type & 0x1f; // fixstr
+      return 1;
+    }
+  unsigned char width; // bytes of the length field
+  switch (type)
+    {
+  case 0xcc:
+  case 0xd0:
+    *size = 1;
+    return 1;
+  case 0xcd:
+  case 0xd1:
+    *size = 2;
+    return 1;
+  case 0xca:
+  case 0xce:
+  case 0xd2:
+    *size = 4;
+    return 1;
+  case 0xcb:
+  case 0xcf:
+  case 0xd3:
+    *size = 8;
+    return 1;
+  case 0xd4: // fixext, type byte and data
+  case 0xd5:
+  case 0xd6:
+  case 0xd7:
+  case 0xd8:
+    *size = 1 + (1 << (type - 0xd4));
+    return 1;
+  case 0xc4: // bin 8
+  case 0xc7: // ext 8
+  case 0xd9: // str 8
+    width = 1;
+    break;
+  case 0xc5:
+  case 0xc8:
+  case 0xda:
+  case 0xdc: // array 16
+  case 0xde: // map 16
+    width = 2;
+    break;
+  case 0xc6:
+  case 0xc9:
+  case 0xdb:
+  case 0xdd:
+  case 0xdf:
+    width = 4;
+    break;
+  default:
+    return EOF; // 0xc1 is never used
+    }
+  if (n < 1u + width)
+    {
+      return 0;
+    }
+  uint32_t length = 0;
+  for (unsigned char i = 1; i <= width; i++)
+    {
+      length = length << 8 | p[i];
+    }
+  if (type == 0xdc || type == 0xdd)
+    {
+      *items = length;
+    }
+  else if (type == 0xde || type == 0xdf)
+    {
+      if (length > 0x7FFFFFFFUL)
+        {
+          return EOF;
+        }
+      *items = 2 * length;
+    }
+  else
+    {
+      *size = length + (type >= 0xc7 && type <= 0xc9 ? 1 : 0); // ext type byte
+    }
+  return 1 + width;
+}
+
+// Length of the MessagePack value at the start of frame, 0 if it is not
+// complete yet, EOF if it is broken.
+static int
+packLength(const unsigned char *frame, size_t len)
+{
+  size_t pos = 0;
+  uint32_t remaining = 1;
+  while (remaining > 0)
+    {
+      uint32_t size, items;
+      int header = unpackHeader(frame + pos, len - pos, &size, &items);
+      if (header <= 0)
+        {
+          return header;
+        }
+      if (size > len - pos - header)
+        {
+          return 0;
+        }
+      pos += header + size;
+      remaining += items - 1;
+    }
+  return pos;
+}
+
+bool
+aJsonFrameStream::available()
+{
+  if (bucket != EOF)
+    return true;
+  if (ready && frame_pos > 0)
+    {
+      /* The previous frame was parsed (or failed to), start over. */
+      ready = false;
+      frame_len = 0;
+    }
+  int ret;
+  while ((ret = collect()) == EOF)
+    ; // dropped an overlong frame, go on with the rest of the input
+  return ret == aJson_FrameReady;
+}
+
+int
+aJsonFrameStream::collect()
+{
+  if (ready)
+    {
+      return aJson_FrameReady;
+    }
+  int ch;
+  // read() returns EOF as soon as the stream is empty, we never wait
+  while ((ch = stream()->read()) != EOF)
+    {
+      if (depth == 0)
+        {
+          if (ch == '{' || ch == '[')
+            {
+              packed = false;
+            }
+          else if (PACK_FRAME(ch))
+            {
+              packed = true;
+            }
+          else
+            {
+              continue; // junk or whitespace between frames
+            }
+          frame_len = 0;
+        }
+      if (frame_len < frame_size)
+        {
+          frame[frame_len++] = ch;
+        }
+      else
+        {
+          /* Too long - drop it and resynchronize on the next '{'. */
+          reset();
+          return EOF;
+        }
+      if (packed)
+        {
+          //MessagePack has no closing bracket, its headers tell the length
+          int length = packLength((const unsigned char*) frame, frame_len);
+          if (length == EOF)
+            {
+              reset();
+              return EOF;
+            }
+          depth = length ? 0 : 1;
+          if (length)
+            {
+              ready = true;
+              frame_pos = 0;
+              return aJson_FrameReady;
+            }
+        }
+      else if (in_string)
+        {
+          if (escape)
+            escape = false;
+          else if (ch == '\\')
+            escape = true;
+          else if (ch == '\"')
+            in_string = false;
+        }
+      else if (ch == '\"')
+        {
+          in_string = true;
+        }
+      else if (ch == '{' || ch == '[')
+        {
+          depth++;
+        }
+      else if (ch == '}' || ch == ']')
+        {
+          if (--depth == 0)
+            {
+              ready = true;
+              frame_pos = 0;
+              return aJson_FrameReady;
+            }
+        }
+    }
+  return aJson_FrameMore;
+}
+
+void
+aJsonFrameStream::reset()
+{
+  frame_len = frame_pos = 0;
+  depth = 0;
+  in_string = escape = ready = packed = false;
+  bucket = EOF;
+}
+
+int
+aJsonFrameStream::getch()
+{
+  if (bucket != EOF)
+    {
+      int ret = bucket;
+      bucket = EOF;
+      return ret;
+    }
+  if (!ready)
+    {
+      reset();
+      return EOF;
+    }
+  if (frame_pos >= frame_len)
+    {
+      return EOF;
+    }
+  return (unsigned char) frame[frame_pos++];
+}
+
 bool
 aJsonStringStream::available()
 {
@@ -156,27 +514,121 @@ aJsonStringStream::getch()
     }
   char ch = *inbuf++;
   inbuf_len--;
-  return ch;
+  return (unsigned char) ch;
 }
 
 size_t
 aJsonStringStream::write(uint8_t ch)
 {
-  if (!outbuf || outbuf_len <= 1)
+  if (out_count + 1 >= outbuf_len && grow)
+    {
+      size_t size = outbuf_len ? outbuf_len * 2 : 32;
+      char *moved = (char*) grow(outbuf, size);
+      if (moved == NULL)
+        {
+          grow = NULL; // keep what we have
+        }
+      else
+        {
+          outbuf = moved;
+          outbuf_len = size;
+        }
+    }
+  out_count++;
+  if (!outbuf)
+    {
+      return 1; // only counting
+    }
+  if (out_count >= outbuf_len)
     {
       return 0;
     }
-  *outbuf++ = ch; outbuf_len--;
-  *outbuf = 0;
+  outbuf[out_count - 1] = ch;
+  outbuf[out_count] = 0;
   return 1;
 }
 
 
+void
+aJsonClass::setArena(void *buffer, size_t size)
+{
+  arena = (char*) buffer;
+  arena_size = size;
+  arena_used = 0;
+  if (arena)
+    {
+      //start aligned, the caller's buffer may be a plain char array
+      size_t skip = (ARENA_ALIGN - ((size_t) arena) % ARENA_ALIGN) % ARENA_ALIGN;
+      arena_used = skip < size ? skip : size;
+    }
+}
+
+void
+aJsonClass::resetArena()
+{
+  setArena(arena, arena_size);
+}
+
+size_t
+aJsonClass::arenaUsed()
+{
+  return arena_used;
+}
+
+void*
+aJsonClass::alloc(size_t size)
+{
+  if (arena == NULL)
+    {
+      return malloc(size);
+    }
+  size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+  if (size > arena_size - arena_used)
+    {
+      return NULL; // arena full, we never fall back to the heap
+    }
+  void* ptr = arena + arena_used;
+  arena_used += size;
+  return ptr;
+}
+
+char*
+aJsonClass::arenaTop(size_t *size)
+{
+  if (arena == NULL)
+    {
+      return NULL;
+    }
+  *size = arena_size - arena_used;
+  return arena + arena_used;
+}
+
+void
+aJsonClass::release(void *ptr)
+{
+  //arena memory is only released by resetArena()
+  if (arena && (char*) ptr >= arena && (char*) ptr < arena + arena_size)
+    {
+      return;
+    }
+  free(ptr);
+}
+
+char*
+aJsonClass::newString(const char *string)
+{
+  size_t len = strlen(string) + 1;
+  char* copy = (char*) alloc(len);
+  if (copy)
+    memcpy(copy, string, len);
+  return copy;
+}
+
 // Internal constructor.
 aJsonObject*
 aJsonClass::newItem()
 {
-  aJsonObject* node = (aJsonObject*) malloc(sizeof(aJsonObject));
+  aJsonObject* node = (aJsonObject*) alloc(sizeof(aJsonObject));
   if (node)
     memset(node, 0, sizeof(aJsonObject));
   return node;
@@ -196,674 +648,2449 @@ aJsonClass::deleteItem(aJsonObject *c)
         }
       if ((c->type == aJson_String) && c->valuestring)
         {
-          free(c->valuestring);
+          release(c->valuestring);
         }
       if (c->name)
         {
-          free(c->name);
+          release(c->name);
         }
-      free(c);
+      release(c);
       c = next;
     }
 }
 
-// Parse the input text to generate a number, and populate the result into item.
-int
-aJsonStream::parseNumber(aJsonObject *item)
+void
+aJsonWriter::reset()
 {
-  int i = 0;
-  char sign = 1;
+  len = 0;
+  comma = false;
+  overflow = false;
+}
 
-  int in = this->getch();
-  if (in == EOF)
-    {
-      return EOF;
-    }
-  // It is easier to decode ourselves than to use sscnaf,
-  // since so we can easier decide between int & double
-  if (in == '-')
-    {
-      //it is a negative number
-      sign = -1;
-      in = this->getch();
-      if (in == EOF)
-        {
-          return EOF;
-        }
-    }
-  if (in >= '0' && in <= '9')
-    do
-      {
-        i = (i * 10) + (in - '0');
-        in = this->getch();
-      }
-    while (in >= '0' && in <= '9'); // Number?
-  //end of integer part  or isn't it?
-  if (!(in == '.' || in == 'e' || in == 'E'))
-    {
-      item->valueint = i * (int) sign;
-      item->type = aJson_Int;
-    }
-  //ok it seems to be a double
+void
+aJsonWriter::put(char ch)
+{
+  if (len < size)
+    buffer[len++] = ch;
   else
-    {
-      double n = (double) i;
-      int scale = 0;
-      int subscale = 0;
-      char signsubscale = 1;
-      if (in == '.')
-        {
-          in = this->getch();
-          do
-            {
-              n = (n * 10.0) + (in - '0'), scale--;
-              in = this->getch();
-            }
-          while (in >= '0' && in <= '9');
-        } // Fractional part?
-      if (in == 'e' || in == 'E') // Exponent?
-        {
-          in = this->getch();
-          if (in == '+')
-            {
-              in = this->getch();
-            }
-          else if (in == '-')
-            {
-              signsubscale = -1;
-              in = this->getch();
-            }
-          while (in >= '0' && in <= '9')
-            {
-              subscale = (subscale * 10) + (in - '0'); // Number?
-              in = this->getch();
-            }
-        }
-
-      n = sign * n * pow(10.0, ((double) scale + (double) subscale
-          * (double) signsubscale)); // number = +/- number.fraction * 10^+/- exponent
-
-      item->valuefloat = n;
-      item->type = aJson_Float;
-    }
-  //preserve the last character for the next routine
-  this->ungetch(in);
-  return 0;
+    overflow = true;
 }
 
-// Render the number nicely from the given item into a string.
-int
-aJsonStream::printInt(aJsonObject *item)
+void
+aJsonWriter::separate()
 {
-  if (item != NULL)
-    {
-      return this->print(item->valueint, DEC);
-    }
-  //printing nothing is ok
-  return 0;
+  if (comma)
+    put(',');
+  comma = false;
 }
 
-int
+void
+aJsonWriter::beginObject()
+{
+  separate();
+  put('{');
+}
+
+void
+aJsonWriter::endObject()
+{
+  put('}');
+  comma = true;
+}
+
+void
+aJsonWriter::beginArray()
+{
+  separate();
+  put('[');
+}
+
+void
+aJsonWriter::endArray()
+{
+  put(']');
+  comma = true;
+}
+
+void
+aJsonWriter::key(const __FlashStringHelper *name)
+{
+  separate();
+  put('\"');
+  PGM_P p = reinterpret_cast<PGM_P>(name);
+  for (char ch = pgm_read_byte(p); ch; ch = pgm_read_byte(++p))
+    put(ch);
+  put('\"');
+  put(':');
+}
+
+void
+aJsonWriter::key(const char *name)
+{
+  key(name, name ? strlen(name) : 0);
+}
+
+void
+aJsonWriter::key(const char *name, size_t length)
+{
+  string(name, length);
+  put(':');
+  comma = false;
+}
+
+// Digits backwards into a small buffer, 16 bit numbers stay in 16 bit math.
+void
+aJsonWriter::number(unsigned int n, bool negative)
+{
+  char digits[5];
+  unsigned char i = 0;
+  do
+    {
+      digits[i++] = '0' + n % 10;
+      n /= 10;
+    }
+  while (n);
+  separate();
+  if (negative)
+    put('-');
+  while (i)
+    put(digits[--i]);
+  comma = true;
+}
+
+void
+aJsonWriter::number(unsigned long n, bool negative)
+{
+  if (n <= UINT_MAX)
+    {
+      number((unsigned int) n, negative);
+      return;
+    }
+  char digits[20];
+  unsigned char i = 0;
+  do
+    {
+      digits[i++] = '0' + n % 10;
+      n /= 10;
+    }
+  while (n);
+  separate();
+  if (negative)
+    put('-');
+  while (i)
+    put(digits[--i]);
+  comma = true;
+}
+
+void
+aJsonWriter::value(int n)
+{
+  //0U - n is the magnitude even for INT_MIN
+  number(n < 0 ? 0U - (unsigned int) n : (unsigned int) n, n < 0);
+}
+
+void
+aJsonWriter::value(unsigned int n)
+{
+  number(n, false);
+}
+
+void
+aJsonWriter::value(long n)
+{
+  number(n < 0 ? 0UL - (unsigned long) n : (unsigned long) n, n < 0);
+}
+
+void
+aJsonWriter::value(unsigned long n)
+{
+  number(n, false);
+}
+
+void
+aJsonWriter::value(bool b)
+{
+  separate();
+  for (const char *p = b ? "true" : "false"; *p; p++)
+    put(*p);
+  comma = true;
+}
+
+void
+aJsonWriter::valueNull()
+{
+  separate();
+  put('n');
+  put('u');
+  put('l');
+  put('l');
+  comma = true;
+}
+
+void
+aJsonWriter::value(const char *string)
+{
+  this->string(string, string ? strlen(string) : 0);
+}
+
+// Same escaping as aJsonStream::printStringPtr().
+void
+aJsonWriter::string(const char *string, size_t length)
+{
+  separate();
+  put('\"');
+  for (; length; string++, length--)
+    {
+      char ch = *string;
+      if ((unsigned char) ch > 31 && ch != '\"' && ch != '\\')
+        {
+          put(ch);
+          continue;
+        }
+      switch (ch)
+        {
+      case '\\':
+      case '\"':
+        break;
+      case '\b':
+        ch = 'b';
+        break;
+      case '\f':
+        ch = 'f';
+        break;
+      case '\n':
+        ch = 'n';
+        break;
+      case '\r':
+        ch = 'r';
+        break;
+      case '\t':
+        ch = 't';
+        break;
+      default:
+        continue; // eviscerate with prejudice.
+        }
+      put('\\');
+      put(ch);
+    }
+  put('\"');
+  comma = true;
+}
+
+// Number of key path segments in path[from, to), from is 0 or at a '.'.
+static unsigned char
+pathDepth(const char *path, size_t from, size_t to)
+{
+  if (from >= to)
+    {
+      return 0;
+    }
+  unsigned char depth = (path[from] == '.') ? 0 : 1;
+  for (; from < to; from++)
+    {
+      if (path[from] == '.')
+        depth++;
+    }
+  return depth;
+}
+
+// Length of the object part of a key path, "AT" of "AT.V1".
+static size_t
+pathParent(const char *path)
+{
+  const char *dot = strrchr(path, '.');
+  return dot ? dot - path : 0;
+}
+
+void
+aJsonWriter::emit(const void *object, const aJsonField *fields,
+    unsigned char count, unsigned long select)
+{
+  const char *base = (const char*) object;
+  const char *open = ""; // path of the last field, its objects are open
+  size_t openlen = 0;
+  beginObject();
+  for (unsigned char i = 0; i < count; i++)
+    {
+      const aJsonField *field = fields + i;
+      if (!(select & (1UL << i)))
+        {
+          continue;
+        }
+      const char *path = field->path;
+      size_t parent = pathParent(path);
+      //keep the objects both paths start with, close the others
+      size_t same = 0;
+      for (size_t j = 0; j <= openlen && j <= parent; j++)
+        {
+          bool end = (j == openlen || open[j] == '.')
+              && (j == parent || path[j] == '.');
+          if (end)
+            same = j;
+          if (j == openlen || j == parent || open[j] != path[j])
+            break;
+        }
+      for (unsigned char depth = pathDepth(open, same, openlen); depth; depth--)
+        {
+          endObject();
+        }
+      for (size_t start = same; start < parent;)
+        {
+          if (path[start] == '.')
+            start++;
+          size_t end = start;
+          while (end < parent && path[end] != '.')
+            end++;
+          key(path + start, end - start);
+          beginObject();
+          start = end;
+        }
+      open = path;
+      openlen = parent;
+
+      const char *name = parent ? path + parent + 1 : path;
+      key(name, strlen(name));
+      const char *member = base + field->offset;
+      switch (field->type)
+        {
+      case aJson_BindInt:
+        value(*(const int*) member);
+        break;
+      case aJson_BindByte:
+        value((unsigned int) *(const unsigned char*) member);
+        break;
+      case aJson_BindLong:
+        value(*(const long*) member);
+        break;
+      case aJson_BindBool:
+        value(*(const bool*) member);
+        break;
+      case aJson_BindChar:
+        string(member, *member ? 1 : 0);
+        break;
+      case aJson_BindString:
+        value(member);
+        break;
+      default:
+        valueNull();
+        break;
+        }
+    }
+  for (unsigned char depth = pathDepth(open, 0, openlen); depth; depth--)
+    {
+      endObject();
+    }
+  endObject();
+}
+
+size_t
+aJsonWriter::send(Print *out)
+{
+  put('\r');
+  put('\n');
+  size_t sent = 0;
+  if (!overflow)
+    sent = out->write((const uint8_t*) buffer, len);
+  reset();
+  return sent;
+}
+
+int
+aJsonTelemetry::add(const char *key, const void *value, unsigned char type,
+    unsigned int min_interval, unsigned int max_interval, bool event)
+{
+  if (count >= size)
+    {
+      return EOF;
+    }
+  aJsonTelemetryField *field = fields + count;
+  field->key = key;
+  field->value = value;
+  field->type = type;
+  field->event = event;
+  field->touched = !event; // sent once at the start
+  field->min_interval = min_interval;
+  field->max_interval = max_interval;
+  field->sent_at = 0UL - min_interval; // due right away
+  count++;
+  field->last = this->value(count - 1);
+  return count - 1;
+}
+
+int
+aJsonTelemetry::add(const char *key, const int *value,
+    unsigned int min_interval, unsigned int max_interval)
+{
+  return add(key, value, aJson_BindInt, min_interval, max_interval, false);
+}
+
+int
+aJsonTelemetry::add(const char *key, const unsigned char *value,
+    unsigned int min_interval, unsigned int max_interval)
+{
+  return add(key, value, aJson_BindByte, min_interval, max_interval, false);
+}
+
+int
+aJsonTelemetry::add(const char *key, const long *value,
+    unsigned int min_interval, unsigned int max_interval)
+{
+  return add(key, value, aJson_BindLong, min_interval, max_interval, false);
+}
+
+int
+aJsonTelemetry::addEvent(const char *key, const int *value)
+{
+  return add(key, value, aJson_BindInt, 0, 0, true);
+}
+
+void
+aJsonTelemetry::touch(int id)
+{
+  if (id >= 0 && id < count)
+    {
+      fields[id].touched = true;
+    }
+}
+
+long
+aJsonTelemetry::value(int id)
+{
+  if (id < 0 || id >= count)
+    {
+      return 0;
+    }
+  const void *value = fields[id].value;
+  switch (fields[id].type)
+    {
+  case aJson_BindByte:
+    return *(const unsigned char*) value;
+  case aJson_BindLong:
+    return *(const long*) value;
+  default:
+    return *(const int*) value;
+    }
+}
+
+bool
+aJsonTelemetry::due(unsigned char id, unsigned long now)
+{
+  aJsonTelemetryField *field = fields + id;
+  unsigned long since = now - field->sent_at;
+  bool changed = field->touched || (!field->event && value(id) != field->last);
+  if (changed && since >= field->min_interval)
+    {
+      return true;
+    }
+  return field->max_interval && since >= field->max_interval;
+}
+
+// Due fields are looked at from start on, wrapping around once.
+int
+aJsonTelemetry::first(unsigned long now)
+{
+  if (count == 0)
+    {
+      return EOF;
+    }
+  from = (start < count) ? start : 0;
+  return due(from, now) ? from : next(now, from);
+}
+
+int
+aJsonTelemetry::next(unsigned long now, int id)
+{
+  if (count == 0)
+    {
+      return EOF;
+    }
+  for (unsigned char i = (id + 1) % count; i != from; i = (i + 1) % count)
+    {
+      if (due(i, now))
+        return i;
+    }
+  return EOF;
+}
+
+void
+aJsonTelemetry::sent(int id, unsigned long now)
+{
+  if (id < 0 || id >= count)
+    {
+      return;
+    }
+  fields[id].last = value(id);
+  fields[id].sent_at = now;
+  fields[id].touched = false;
+  start = (id + 1) % count;
+}
+
+// Chars of n in decimal, with the sign.
+static unsigned char
+numberLength(long n)
+{
+  unsigned char len = (n < 0) ? 2 : 1;
+  unsigned long u = (n < 0) ? 0UL - (unsigned long) n : (unsigned long) n;
+  while (u >= 10)
+    {
+      u /= 10;
+      len++;
+    }
+  return len;
+}
+
+unsigned char
+aJsonTelemetry::write(aJsonWriter *out, unsigned long now, size_t budget)
+{
+  unsigned char written = 0;
+  int left = EOF;
+  for (int id = first(now); id != EOF; id = next(now, id))
+    {
+      long value = this->value(id);
+      // ,"key":value
+      size_t cost = 1 + strlen(fields[id].key) + 3 + numberLength(value);
+      if (cost > budget)
+        {
+          if (left == EOF)
+            left = id;
+          continue;
+        }
+      budget -= cost;
+      out->key(fields[id].key);
+      out->value(value);
+      sent(id, now);
+      written++;
+    }
+  if (left != EOF)
+    {
+      start = left; // the first one left out goes first next time
+    }
+  return written;
+}
+
+int
+aJsonTape::parse(aJsonStream *stream)
+{
+  len = 0;
+  if (this->parseValue(stream) == EOF)
+    {
+      len = 0;
+      return EOF;
+    }
+  return 0;
+}
+
+int
+aJsonTape::parse(char *value)
+{
+  aJsonStringStream stringStream(value, NULL);
+  return parse(&stringStream);
+}
+
+// Append an item with value bytes behind its first word.
+int
+aJsonTape::put(char type, const void *value, size_t bytes)
+{
+  if (len + 1 + TAPE_WORDS(bytes) > size)
+    {
+      return EOF; // tape full
+    }
+  tape[len++] = TAPE_ENTRY(type, 0);
+  memcpy(tape + len, value, bytes);
+  len += TAPE_WORDS(bytes);
+  return 0;
+}
+
+// Decode the string inline, behind its first word.
+int
+aJsonTape::parseString(aJsonStream *stream)
+{
+  if (len >= size)
+    {
+      return EOF;
+    }
+  size_t space = (size - len - 1) * 2;
+  int length = stream->readString((char *) (tape + len + 1), space);
+  if (length == EOF || (size_t) length >= space
+      || length > aJson_TapeSize(0xFFFF))
+    {
+      return EOF; // does not fit
+    }
+  tape[len] = TAPE_ENTRY(aJson_String, length);
+  len += 1 + TAPE_WORDS(length + 1);
+  return 0;
+}
+
+// Same grammar as aJsonStream::parseValue(), written to the tape.
+int
+aJsonTape::parseValue(aJsonStream *stream)
+{
+  if (stream->skip() == EOF)
+    {
+      return EOF;
+    }
+  int in = stream->getch();
+  if (in == EOF)
+    {
+      return EOF;
+    }
+  if (in == '{' || in == '[')
+    {
+      char end = (in == '{') ? '}' : ']';
+      size_t start = len;
+      if (this->put(end == '}' ? aJson_Object : aJson_Array, NULL, 0) == EOF)
+        {
+          return EOF;
+        }
+      stream->skip();
+      in = stream->getch();
+      if (in != end)
+        {
+          stream->ungetch(in);
+          do
+            {
+              if (end == '}')
+                {
+                  stream->skip();
+                  if (this->parseString(stream) == EOF)
+                    {
+                      return EOF;
+                    }
+                  stream->skip();
+                  if (stream->getch() != ':')
+                    {
+                      return EOF; // fail!
+                    }
+                }
+              if (this->parseValue(stream) == EOF)
+                {
+                  return EOF;
+                }
+              stream->skip();
+              in = stream->getch();
+            }
+          while (in == ',');
+          if (in != end)
+            {
+              return EOF; // malformed.
+            }
+        }
+      size_t content = len - start - 1;
+      if (content > aJson_TapeSize(0xFFFF))
+        {
+          return EOF;
+        }
+      tape[start] |= content;
+      return 0;
+    }
+  stream->ungetch(in);
+  if (in == '\"')
+    {
+      return this->parseString(stream);
+    }
+  if (in >= 0x80)
+    {
+      return EOF; // MessagePack is not read into tapes
+    }
+  //numbers and literals, parsed into a temporary item like parseEvent()
+  aJsonObject item;
+  if (stream->parseValue(&item, NULL) == EOF)
+    {
+      return EOF;
+    }
+  switch (item.type)
+    {
+  case aJson_Int:
+    return this->put(aJson_Int, &item.valueint, sizeof(item.valueint));
+#if !aJson_IntegerOnly
+  case aJson_Float:
+    return this->put(aJson_Float, &item.valuefloat, sizeof(item.valuefloat));
+#endif
+  case aJson_True:
+  case aJson_False:
+  case aJson_NULL:
+    return this->put(item.type, NULL, 0);
+  default:
+    return EOF;
+    }
+}
+
+// Words of item including its first one, the jump to the next item.
+size_t
+aJsonTape::words(int item)
+{
+  uint16_t word = tape[item];
+  switch (aJson_TapeType(word))
+    {
+  case aJson_Object:
+  case aJson_Array:
+    return 1 + aJson_TapeSize(word);
+  case aJson_String:
+    return 1 + TAPE_WORDS(aJson_TapeSize(word) + 1);
+  case aJson_Int:
+    return 1 + TAPE_WORDS(sizeof(int));
+#if !aJson_IntegerOnly
+  case aJson_Float:
+    return 1 + TAPE_WORDS(sizeof(double));
+#endif
+  default:
+    return 1;
+    }
+}
+
+char
+aJsonTape::getType(int item)
+{
+  if (item < 0 || (size_t) item >= len)
+    {
+      return EOF;
+    }
+  return aJson_TapeType(tape[item]);
+}
+
+unsigned char
+aJsonTape::getArraySize(int array)
+{
+  char type = getType(array);
+  if (type != aJson_Array && type != aJson_Object)
+    {
+      return 0;
+    }
+  size_t i = array + 1;
+  size_t end = i + aJson_TapeSize(tape[array]);
+  unsigned char count = 0;
+  while (i < end)
+    {
+      if (type == aJson_Object)
+        {
+          i += words(i); // key
+        }
+      i += words(i);
+      count++;
+    }
+  return count;
+}
+
+int
+aJsonTape::getArrayItem(int array, unsigned char index)
+{
+  char type = getType(array);
+  if (type != aJson_Array && type != aJson_Object)
+    {
+      return EOF;
+    }
+  size_t i = array + 1;
+  size_t end = i + aJson_TapeSize(tape[array]);
+  while (i < end)
+    {
+      if (type == aJson_Object)
+        {
+          i += words(i); // key
+        }
+      if (index-- == 0)
+        {
+          return i;
+        }
+      i += words(i);
+    }
+  return EOF;
+}
+
+int
+aJsonTape::getObjectItem(int object, const char *key)
+{
+  if (getType(object) != aJson_Object)
+    {
+      return EOF;
+    }
+  size_t i = object + 1;
+  size_t end = i + aJson_TapeSize(tape[object]);
+  while (i < end)
+    {
+      size_t value = i + words(i);
+      if (!strcasecmp((const char *) (tape + i + 1), key))
+        {
+          return value;
+        }
+      i = value + words(value);
+    }
+  return EOF;
+}
+
+int
+aJsonTape::intValue(int item)
+{
+  int number;
+  switch (getType(item))
+    {
+  case aJson_Int:
+    memcpy(&number, tape + item + 1, sizeof(number));
+    return number;
+#if !aJson_IntegerOnly
+  case aJson_Float:
+    return floatValue(item);
+#endif
+  default:
+    return 0;
+    }
+}
+
+#if !aJson_IntegerOnly
+double
+aJsonTape::floatValue(int item)
+{
+  double number;
+  switch (getType(item))
+    {
+  case aJson_Float:
+    memcpy(&number, tape + item + 1, sizeof(number));
+    return number;
+  case aJson_Int:
+    return intValue(item);
+  default:
+    return 0;
+    }
+}
+#endif
+
+const char*
+aJsonTape::stringValue(int item)
+{
+  if (getType(item) != aJson_String)
+    {
+      return NULL;
+    }
+  return (const char *) (tape + item + 1);
+}
+
+bool
+aJsonTape::boolValue(int item)
+{
+  return getType(item) == aJson_True;
+}
+
+// Parse the input text to generate a number, and populate the result into item.
+// The digits are collected into an integer mantissa with a decimal exponent,
+// so integers never touch floating point and fractions need no pow().
+int
+aJsonStream::parseNumber(aJsonObject *item)
+{
+  unsigned long mantissa = 0;
+  int exponent = 0;
+  bool negative = false;
+  bool fraction = false;
+
+  int in = this->getch();
+  if (in == EOF)
+    {
+      return EOF;
+    }
+  if (in == '-')
+    {
+      //it is a negative number
+      negative = true;
+      in = this->getch();
+      if (in == EOF)
+        {
+          return EOF;
+        }
+    }
+  //integer part, digits that do not fit any more only scale the number
+  while (in >= '0' && in <= '9')
+    {
+      if (mantissa <= MANTISSA_LIMIT)
+        mantissa = mantissa * 10 + (in - '0');
+      else
+        exponent++;
+      in = this->getch();
+    }
+  //fractional part, digits that do not fit any more are dropped
+  if (in == '.')
+    {
+      fraction = true;
+      in = this->getch();
+      while (in >= '0' && in <= '9')
+        {
+          if (mantissa <= MANTISSA_LIMIT)
+            {
+              mantissa = mantissa * 10 + (in - '0');
+              exponent--;
+            }
+          in = this->getch();
+        }
+    }
+  //exponent
+  if (in == 'e' || in == 'E')
+    {
+      fraction = true;
+      bool negative_exponent = false;
+      int e = 0;
+      in = this->getch();
+      if (in == '+')
+        {
+          in = this->getch();
+        }
+      else if (in == '-')
+        {
+          negative_exponent = true;
+          in = this->getch();
+        }
+      while (in >= '0' && in <= '9')
+        {
+          if (e < EXPONENT_LIMIT)
+            e = e * 10 + (in - '0');
+          in = this->getch();
+        }
+      exponent += negative_exponent ? -e : e;
+    }
+  //preserve the last character for the next routine
+  this->ungetch(in);
+
+#if aJson_IntegerOnly
+  (void) fraction; // we make an int of it anyway
+  //scale to an integer, the fraction is cut off
+  for (; exponent < 0 && mantissa; exponent++)
+    mantissa /= 10;
+  for (; exponent > 0 && mantissa; exponent--)
+    {
+      if (mantissa > (unsigned long) INT_MAX)
+        {
+          return EOF; // overflow
+        }
+      mantissa *= 10;
+    }
+#else
+  if (fraction || exponent != 0
+      || mantissa > (unsigned long) INT_MAX + (negative ? 1 : 0))
+    {
+      //ok it is a double (or an int too big for int)
+      double scale = 1.0;
+      unsigned int e = exponent < 0 ? -exponent : exponent;
+      for (; e >= 64; e -= 32)
+        scale *= powers_of_10[5];
+      for (unsigned char i = 0; e; i++, e >>= 1)
+        if (e & 1)
+          scale *= powers_of_10[i];
+      double n = exponent < 0 ? mantissa / scale : mantissa * scale;
+      item->valuefloat = negative ? -n : n;
+      item->type = aJson_Float;
+      return 0;
+    }
+#endif
+  if (mantissa > (unsigned long) INT_MAX + (negative ? 1 : 0))
+    {
+      return EOF; // overflow
+    }
+  //-(mantissa - 1) - 1 does not overflow for INT_MIN
+  item->valueint = negative && mantissa ? -(int) (mantissa - 1) - 1 : (int) mantissa;
+  item->type = aJson_Int;
+  return 0;
+}
+
+// Render the number nicely from the given item into a string.
+int
+aJsonStream::printInt(aJsonObject *item)
+{
+  if (item != NULL)
+    {
+      return this->print(item->valueint, DEC);
+    }
+  //printing nothing is ok
+  return 0;
+}
+
+#if !aJson_IntegerOnly
+int
 aJsonStream::printFloat(aJsonObject *item)
 {
-  if (item != NULL)
+  if (item != NULL)
+    {
+      double d = item->valuefloat;
+      if (d<0.0) {
+	  this->print("-");
+          d=-d;
+      }
+      //print the integer part
+      unsigned long integer_number = (unsigned long)d;
+      this->print(integer_number, DEC);
+      this->print(".");
+      //print the fractional part
+      double fractional_part = d - ((double)integer_number);
+      //we do a do-while since we want to print at least one zero
+      //we just support a certain number of digits after the '.'
+      int n = FLOAT_PRECISION;
+      fractional_part += FLOAT_ROUNDING;
+      do {
+          //make the first digit non fractional(shift it before the '.'
+          fractional_part *= 10.0;
+          //create an int out of it
+          unsigned int digit = (unsigned int) fractional_part;
+          //print it
+	  this->print(digit, DEC);
+          //remove it from the number
+          fractional_part -= (double)digit;
+          n--;
+      } while ((fractional_part!=0) && (n>0));
+    }
+  //printing nothing is ok
+  return 0;
+}
+#endif
+
+// Parse the input text into an unescaped cstring.
+int
+aJsonStream::readString(char *buffer, size_t len)
+{
+  int in = this->getch();
+  if (in != '\"')
+    {
+      return EOF; // not a string!
+    }
+  int length = 0;
+  in = this->getch();
+  while (in != '\"' && in >= 32)
+    {
+      if (in == '\\')
+        {
+          in = this->getch();
+          switch (in)
+            {
+          case '\\':
+          case '\"':
+            break;
+          case 'b':
+            in = '\b';
+            break;
+          case 'f':
+            in = '\f';
+            break;
+          case 'n':
+            in = '\n';
+            break;
+          case 'r':
+            in = '\r';
+            break;
+          case 't':
+            in = '\t';
+            break;
+          case EOF:
+            return EOF;
+          default:
+            //we do not understand it so we skip it
+            in = 0;
+            break;
+            }
+        }
+      if (in)
+        {
+          //no need to clear the buffer, we only write what we decode
+          if ((size_t) length + 1 < len)
+            {
+              buffer[length] = in;
+            }
+          length++;
+        }
+      in = this->getch();
+    }
+  if (in == EOF)
+    {
+      return EOF;
+    }
+  //the string ends here
+  if (len > 0)
+    {
+      buffer[(size_t) length < len ? length : len - 1] = 0;
+    }
+  return length;
+}
+
+// Parse the input text into an unescaped cstring, and populate item.
+int
+aJsonStream::parseString(aJsonObject *item)
+{
+  return this->parseString(item, -1);
+}
+
+int
+aJsonStream::parseString(aJsonObject *item, long pack_length)
+{
+  item->type = aJson_String;
+  size_t size;
+  char* top = aJsonClass::arenaTop(&size);
+  if (top)
+    {
+      //decode in place at the top of the arena and keep exactly what we used
+      int length = pack_length < 0 ? this->readString(top, size)
+          : this->readPackString(top, size, pack_length);
+      if (length == EOF || (size_t) length >= size)
+        {
+          return EOF; // arena full
+        }
+      item->valuestring = (char*) aJsonClass::alloc(length + 1);
+      return item->valuestring ? 0 : EOF;
+    }
+  //no arena, alloc() is malloc(): decode into the block that is kept
+  //and give back what was not used
+  char* buffer = (char*) malloc(aJson_HeapStringSize);
+  if (buffer == NULL)
+    {
+      return EOF; // memory fail
+    }
+  int length = pack_length < 0 ? this->readString(buffer, aJson_HeapStringSize)
+      : this->readPackString(buffer, aJson_HeapStringSize, pack_length);
+  if (length == EOF || (size_t) length >= aJson_HeapStringSize)
+    {
+      free(buffer);
+      return EOF; // too long, fails like a full arena - never cut
+    }
+  char* shrunk = (char*) realloc(buffer, length + 1);
+  item->valuestring = shrunk ? shrunk : buffer;
+  return 0;
+}
+
+// Render the cstring provided to an escaped version that can be printed.
+int
+aJsonStream::printStringPtr(const char *str)
+{
+  this->print("\"");
+  char* ptr = (char*) str;
+  if (ptr != NULL)
+    {
+      while (*ptr != 0)
+        {
+          if ((unsigned char) *ptr > 31 && *ptr != '\"' && *ptr != '\\')
+            {
+	      this->print(*ptr);
+              ptr++;
+            }
+          else
+            {
+	      this->print('\\');
+              switch (*ptr++)
+                {
+              case '\\':
+		this->print('\\');
+                break;
+              case '\"':
+		this->print('\"');
+                break;
+              case '\b':
+		this->print('b');
+                break;
+              case '\f':
+		this->print('f');
+                break;
+              case '\n':
+		this->print('n');
+                break;
+              case '\r':
+		this->print('r');
+                break;
+              case '\t':
+		this->print('t');
+                break;
+              default:
+                break; // eviscerate with prejudice.
+                }
+            }
+
+        }
+    }
+  this->print('\"');
+  return 0;
+}
+
+// Invote print_string_ptr (which is useful) on an item.
+int
+aJsonStream::printString(aJsonObject *item)
+{
+  return this->printStringPtr(item->valuestring);
+}
+
+// Utility to jump whitespace and cr/lf
+int
+aJsonStream::skip()
+{
+  int in = this->getch();
+  while (in != EOF && (in <= 32))
     {
-      double d = item->valuefloat;
-      if (d<0.0) {
-	  this->print("-");
-          d=-d;
-      }
-      //print the integer part
-      unsigned long integer_number = (unsigned long)d;
-      this->print(integer_number, DEC);
-      this->print(".");
-      //print the fractional part
-      double fractional_part = d - ((double)integer_number);
-      //we do a do-while since we want to print at least one zero
-      //we just support a certain number of digits after the '.'
-      int n = FLOAT_PRECISION;
-      fractional_part += 0.5/pow(10.0, FLOAT_PRECISION);
-      do {
-          //make the first digit non fractional(shift it before the '.'
-          fractional_part *= 10.0;
-          //create an int out of it
-          unsigned int digit = (unsigned int) fractional_part;
-          //print it
-	  this->print(digit, DEC);
-          //remove it from the number
-          fractional_part -= (double)digit;
-          n--;
-      } while ((fractional_part!=0) && (n>0));
+      in = this->getch();
+    }
+  if (in != EOF)
+    {
+      this->ungetch(in);
+      return 0;
+    }
+  return EOF;
+}
+
+// Utility to flush our buffer in case it contains garbage
+// since the parser will return the buffer untouched if it
+// cannot understand it.
+int
+aJsonStream::flush()
+{
+  int in = this->getch();
+  while(in != EOF)
+  {
+    in = this->getch();
+  }
+  return EOF;
+}
+
+
+// Parse an object - create a new root, and populate.
+aJsonObject*
+aJsonClass::parse(char *value)
+{
+  aJsonStringStream stringStream(value, NULL);
+  aJsonObject* result = parse(&stringStream);
+  return result;
+}
+
+// Parse an object - create a new root, and populate.
+aJsonObject*
+aJsonClass::parse(aJsonStream* stream)
+{
+  return parse(stream, NULL);
+}
+
+// Parse an object - create a new root, and populate.
+aJsonObject*
+aJsonClass::parse(aJsonStream* stream, char** filter)
+{
+  if (stream == NULL)
+    {
+      return NULL;
+    }
+  aJsonObject *c = newItem();
+  if (!c)
+    return NULL; /* memory fail */
+
+  stream->skip();
+  if (stream->parseValue(c, filter) == EOF)
+    {
+      deleteItem(c);
+      return NULL;
+    }
+  return c;
+}
+
+// Render a aJsonObject item/entity/structure to text.
+int
+aJsonClass::print(aJsonObject* item, aJsonStream* stream)
+{
+  return stream->printValue(item);
+}
+
+int
+aJsonClass::pack(aJsonObject* item, aJsonStream* stream)
+{
+  return stream->packValue(item);
+}
+
+char*
+aJsonClass::print(aJsonObject* item)
+{
+  int length = print(item, NULL, 0);
+  if (length == EOF)
+    {
+      return NULL;
+    }
+  char* outBuf = (char*) malloc(length + 1);
+  if (outBuf == NULL)
+    {
+      return NULL;
+    }
+  print(item, outBuf, length + 1);
+  return outBuf;
+}
+
+int
+aJsonClass::print(aJsonObject* item, char *buffer, size_t size)
+{
+  aJsonStringStream stringStream(NULL, buffer, size);
+  if (print(item, &stringStream) == EOF)
+    {
+      return EOF;
+    }
+  return stringStream.length();
+}
+
+// Parser core - when encountering text, process appropriately.
+int
+aJsonStream::parseValue(aJsonObject *item, char** filter)
+{
+  //the key path is only needed to match it against the filter
+  char path[aJson_PathSize];
+  path[0] = 0;
+  return this->parseValue(item, filter, filter ? path : NULL);
+}
+
+int
+aJsonStream::parseValue(aJsonObject *item, char** filter, char *path)
+{
+  if (this->skip() == EOF)
+    {
+      return EOF;
+    }
+  //read the first byte from the stream
+  int in = this->getch();
+  if (in == EOF)
+    {
+      return EOF;
+    }
+  this->ungetch(in);
+  if (in == '\"')
+    {
+      return this->parseString(item);
+    }
+  else if (in == '-' || (in >= '0' && in <= '9'))
+    {
+      return this->parseNumber(item);
+    }
+  else if (in == '[')
+    {
+      return this->parseArray(item, filter, path);
+    }
+  else if (in == '{')
+    {
+      return this->parseObject(item, filter, path);
+    }
+  else if (in >= 0x80)
+    {
+      return this->parsePack(item, filter, path);
+    }
+  //it can only be null, false or true
+  else if (in == 'n')
+    {
+      //a buffer to read the value
+      char buffer[] =
+        { 0, 0, 0, 0 };
+      if (this->readBytes((uint8_t*) buffer, 4) != 4)
+        {
+          return EOF;
+        }
+      if (!strncmp(buffer, "null", 4))
+        {
+          item->type = aJson_NULL;
+          return 0;
+        }
+      else
+        {
+          return EOF;
+        }
+    }
+  else if (in == 'f')
+    {
+      //a buffer to read the value
+      char buffer[] =
+        { 0, 0, 0, 0, 0 };
+      if (this->readBytes((uint8_t*) buffer, 5) != 5)
+        {
+          return EOF;
+        }
+      if (!strncmp(buffer, "false", 5))
+        {
+          item->type = aJson_False;
+          item->valuebool = 0;
+          return 0;
+        }
+    }
+  else if (in == 't')
+    {
+      //a buffer to read the value
+      char buffer[] =
+        { 0, 0, 0, 0 };
+      if (this->readBytes((uint8_t*) buffer, 4) != 4)
+        {
+          return EOF;
+        }
+      if (!strncmp(buffer, "true", 4))
+        {
+          item->type = aJson_True;
+          item->valuebool = -1;
+          return 0;
+        }
     }
-  //printing nothing is ok
-  return 0;
+
+  return EOF; // failure.
 }
 
-// Parse the input text into an unescaped cstring, and populate item.
+// Render a value to text.
 int
-aJsonStream::parseString(aJsonObject *item)
+aJsonStream::printValue(aJsonObject *item)
 {
-  //we do not need to skip here since the first byte should be '\"'
-  int in = this->getch();
-  if (in != '\"')
+  int result = 0;
+  if (item == NULL)
     {
-      return EOF; // not a string!
+      //nothing to do
+      return 0;
     }
-  item->type = aJson_String;
-  //allocate a buffer & track how long it is and how much we have read
-  string_buffer* buffer = stringBufferCreate();
-  if (buffer == NULL)
+  switch (item->type)
     {
-      //unable to allocate the string
-      return EOF;
+  case aJson_NULL:
+    result = this->print("null");
+    break;
+  case aJson_False:
+    result = this->print("false");
+    break;
+  case aJson_True:
+    result = this->print("true");
+    break;
+  case aJson_Int:
+    result = this->printInt(item);
+    break;
+#if !aJson_IntegerOnly
+  case aJson_Float:
+    result = this->printFloat(item);
+    break;
+#endif
+  case aJson_String:
+    result = this->printString(item);
+    break;
+  case aJson_Array:
+    result = this->printArray(item);
+    break;
+  case aJson_Object:
+    result = this->printObject(item);
+    break;
+    }
+  return result;
+}
+
+// Build an array from input text.
+int
+aJsonStream::parseArray(aJsonObject *item, char** filter, char *path)
+{
+  int in = this->getch();
+  if (in != '[')
+    {
+      return EOF; // not an array!
     }
+
+  item->type = aJson_Array;
+  this->skip();
   in = this->getch();
-  if (in == EOF)
+  //check for empty array
+  if (in == ']')
+    {
+      return 0; // empty array.
+    }
+  //now put back the last character
+  this->ungetch(in);
+  aJsonObject *child;
+  char first = -1;
+  while ((first) || (in == ','))
+    {
+      aJsonObject *new_item = aJsonClass::newItem();
+      if (new_item == NULL)
+        {
+          return EOF; // memory fail
+        }
+      if (first)
+        {
+          item->child = new_item;
+          first = 0;
+        }
+      else
+        {
+          child->next = new_item;
+          new_item->prev = child;
+        }
+      child = new_item;
+      this->skip();
+      //array items have no key, they share the path of the array
+      if (this->parseValue(child, filter, path))
+        {
+          return EOF;
+        }
+      this->skip();
+      in = this->getch();
+    }
+  if (in == ']')
+    {
+      return 0; // end of array
+    }
+  else
+    {
+      return EOF; // malformed.
+    }
+}
+
+// Render an array to text
+int
+aJsonStream::printArray(aJsonObject *item)
+{
+  if (item == NULL)
+    {
+      //nothing to do
+      return 0;
+    }
+  aJsonObject *child = item->child;
+  if (this->print('[') == EOF)
     {
-      stringBufferFree(buffer);
       return EOF;
     }
-  while (in != EOF)
+  while (child)
     {
-      while (in != '\"' && in >= 32)
+      if (this->printValue(child) == EOF)
         {
-          if (in != '\\')
-            {
-              stringBufferAdd((char) in, buffer);
-            }
-          else
-            {
-              in = this->getch();
-              if (in == EOF)
-                {
-                  stringBufferFree(buffer);
-                  return EOF;
-                }
-              switch (in)
-                {
-              case '\\':
-                stringBufferAdd('\\', buffer);
-                break;
-              case '\"':
-                stringBufferAdd('\"', buffer);
-                break;
-              case 'b':
-                stringBufferAdd('\b', buffer);
-                break;
-              case 'f':
-                stringBufferAdd('\f', buffer);
-                break;
-              case 'n':
-                stringBufferAdd('\n', buffer);
-                break;
-              case 'r':
-                stringBufferAdd('\r', buffer);
-                break;
-              case 't':
-                stringBufferAdd('\t', buffer);
-                break;
-              default:
-                //we do not understand it so we skip it
-                break;
-                }
-            }
-          in = this->getch();
-          if (in == EOF)
+          return EOF;
+        }
+      child = child->next;
+      if (child)
+        {
+          if (this->print(',') == EOF)
             {
-              stringBufferFree(buffer);
               return EOF;
             }
         }
-      //the string ends here
-      item->valuestring = stringBufferToString(buffer);
-      return 0;
     }
-  //we should not be here but it is ok
+  if (this->print(']') == EOF)
+    {
+      return EOF;
+    }
   return 0;
 }
 
-// Render the cstring provided to an escaped version that can be printed.
+// Is the value at path or anything below it wanted by the filter?
+static bool
+filterMatch(char** filter, const char *path)
+{
+  size_t len = strlen(path);
+  for (; *filter; filter++)
+    {
+      size_t filter_len = strlen(*filter);
+      size_t n = filter_len < len ? filter_len : len;
+      if (strncasecmp(*filter, path, n))
+        {
+          continue;
+        }
+      //equal, or one is a parent of the other
+      if (filter_len == len || (filter_len < len ? path[n] : (*filter)[n]) == '.')
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+// Build an object from the text.
 int
-aJsonStream::printStringPtr(const char *str)
+aJsonStream::parseObject(aJsonObject *item, char** filter, char *path)
 {
-  this->print("\"");
-  char* ptr = (char*) str;
-  if (ptr != NULL)
+  int in = this->getch();
+  if (in != '{')
     {
-      while (*ptr != 0)
+      return EOF; // not an object!
+    }
+
+  item->type = aJson_Object;
+  this->skip();
+  //check for an empty object
+  in = this->getch();
+  if (in == '}')
+    {
+      return 0; // empty object.
+    }
+  //preserve the char for the next parser
+  this->ungetch(in);
+
+  size_t len = path ? strlen(path) : 0;
+  aJsonObject* child = NULL;
+  char first = -1;
+  while ((first) || (in == ','))
+    {
+      first = 0;
+      this->skip();
+      bool wanted = true;
+      size_t keylen = len;
+      if (filter)
         {
-          if ((unsigned char) *ptr > 31 && *ptr != '\"' && *ptr != '\\')
+          //read the key into the path, unwanted keys never become items
+          if (keylen > 0 && keylen < aJson_PathSize - 1)
             {
-	      this->print(*ptr);
-              ptr++;
+              path[keylen++] = '.';
+            }
+          int length = this->readString(path + keylen, aJson_PathSize - keylen);
+          if (length == EOF || (size_t) length >= aJson_PathSize - keylen)
+            {
+              return EOF; // the key path does not fit, never cut
+            }
+          wanted = filterMatch(filter, path);
+        }
+      if (wanted)
+        {
+          aJsonObject* new_item = aJsonClass::newItem();
+          if (new_item == NULL)
+            {
+              return EOF; // memory fail
+            }
+          if (child == NULL)
+            {
+              item->child = new_item;
             }
           else
             {
-	      this->print('\\');
-              switch (*ptr++)
+              child->next = new_item;
+              new_item->prev = child;
+            }
+          child = new_item;
+          if (filter)
+            {
+              child->name = aJsonClass::newString(path + keylen);
+              if (child->name == NULL)
                 {
-              case '\\':
-		this->print('\\');
-                break;
-              case '\"':
-		this->print('\"');
-                break;
-              case '\b':
-		this->print('b');
-                break;
-              case '\f':
-		this->print('f');
-                break;
-              case '\n':
-		this->print('n');
-                break;
-              case '\r':
-		this->print('r');
-                break;
-              case '\t':
-		this->print('t');
-                break;
-              default:
-                break; // eviscerate with prejudice.
+                  return EOF; // memory fail
                 }
             }
-
+          else
+            {
+              if (this->parseString(child) == EOF)
+                {
+                  return EOF;
+                }
+              child->name = child->valuestring;
+              child->valuestring = NULL;
+            }
+          child->hash = aJsonClass::hash(child->name);
+        }
+      this->skip();
+      in = this->getch();
+      if (in != ':')
+        {
+          return EOF; // fail!
+        }
+      // skip any spacing, get the value.
+      this->skip();
+      if ((wanted ? this->parseValue(child, filter, path) : this->skipValue())
+          == EOF)
+        {
+          return EOF;
+        }
+      if (path)
+        {
+          path[len] = 0;
         }
+      this->skip();
+      in = this->getch();
+    }
+
+  if (in == '}')
+    {
+      return 0; // end of array
+    }
+  else
+    {
+      return EOF; // malformed.
     }
-  this->print('\"');
-  return 0;
 }
 
-// Invote print_string_ptr (which is useful) on an item.
+// Read over a value, only strings and nesting are looked at.
 int
-aJsonStream::printString(aJsonObject *item)
+aJsonStream::skipValue()
 {
-  return this->printStringPtr(item->valuestring);
+  unsigned char depth = 0;
+  for (;;)
+    {
+      int in = this->getch();
+      switch (in)
+        {
+      case EOF:
+        return EOF;
+      case '\"':
+        do
+          {
+            in = this->getch();
+            if (in == '\\')
+              {
+                in = this->getch(); // whatever is escaped
+                if (in == EOF)
+                  {
+                    return EOF;
+                  }
+                in = 0;
+              }
+            else if (in == EOF)
+              {
+                return EOF;
+              }
+          }
+        while (in != '\"');
+        if (depth == 0)
+          {
+            return 0;
+          }
+        break;
+      case '{':
+      case '[':
+        depth++;
+        break;
+      case '}':
+      case ']':
+        if (depth == 0)
+          {
+            //end of the enclosing object, it ends a number or literal
+            this->ungetch(in);
+            return 0;
+          }
+        if (--depth == 0)
+          {
+            return 0;
+          }
+        break;
+      case ',':
+        if (depth == 0)
+          {
+            this->ungetch(in);
+            return 0;
+          }
+        break;
+      default:
+        if (depth == 0 && in <= ' ')
+          {
+            return 0; // whitespace ends a number or literal
+          }
+        break;
+        }
+    }
 }
 
-// Utility to jump whitespace and cr/lf
-int
-aJsonStream::skip()
+#if !aJson_IntegerOnly
+// IEEE 754 double from its big endian halves, also where double is a float (AVR).
+static double
+unpackDouble(uint32_t high, uint32_t low)
 {
-  int in = this->getch();
-  while (in != EOF && (in <= 32))
+  if (sizeof(double) == 8)
     {
-      in = this->getch();
+      uint64_t bits = (uint64_t) high << 32 | low;
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      return d;
     }
-  if (in != EOF)
+  uint32_t bits = high & 0x80000000UL;
+  int exponent = (int) ((high >> 20) & 0x7FF) - 1023 + 127;
+  if (exponent == 0x7FF - 1023 + 127)
     {
-      this->ungetch(in);
-      return 0;
+      bits |= 0x7F800000UL | ((high & 0xFFFFF) | low ? 0x400000UL : 0); // inf, nan
     }
-  return EOF;
+  else if (exponent >= 0xFF)
+    {
+      bits |= 0x7F800000UL; // too large for a float
+    }
+  else if (exponent > 0)
+    {
+      bits |= (uint32_t) exponent << 23 | (high & 0xFFFFF) << 3 | low >> 29;
+    }
+  //else too small for a float, 0
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
 }
+#endif
 
-// Utility to flush our buffer in case it contains garbage
-// since the parser will return the buffer untouched if it
-// cannot understand it.
 int
-aJsonStream::flush()
-{
-  int in = this->getch();
-  while(in != EOF)
-  {
-    in = this->getch();
-  }
-  return EOF;
-}
-
-
-// Parse an object - create a new root, and populate.
-aJsonObject*
-aJsonClass::parse(char *value)
+aJsonStream::readPack(unsigned char bytes, uint32_t *value)
 {
-  aJsonStringStream stringStream(value, NULL);
-  aJsonObject* result = parse(&stringStream);
-  return result;
+  *value = 0;
+  while (bytes--)
+    {
+      int in = this->getch();
+      if (in == EOF)
+        {
+          return EOF;
+        }
+      *value = *value << 8 | in;
+    }
+  return 0;
 }
 
-// Parse an object - create a new root, and populate.
-aJsonObject*
-aJsonClass::parse(aJsonStream* stream)
+int
+aJsonStream::readPackHeader(uint32_t *size, uint32_t *items)
 {
-  return parse(stream, NULL);
+  unsigned char header[5];
+  size_t n = 0;
+  int length;
+  do
+    {
+      int in = this->getch();
+      if (in == EOF)
+        {
+          return EOF;
+        }
+      header[n++] = in;
+      length = unpackHeader(header, n, size, items);
+    }
+  while (length == 0);
+  return length == EOF ? EOF : header[0];
 }
 
-// Parse an object - create a new root, and populate.
-aJsonObject*
-aJsonClass::parse(aJsonStream* stream, char** filter)
+int
+aJsonStream::readPackString(char *buffer, size_t len, long length)
 {
-  if (stream == NULL)
+  for (long i = 0; i < length; i++)
     {
-      return NULL;
+      int in = this->getch();
+      if (in == EOF)
+        {
+          return EOF;
+        }
+      if ((size_t) i + 1 < len)
+        {
+          buffer[i] = in;
+        }
     }
-  aJsonObject *c = newItem();
-  if (!c)
-    return NULL; /* memory fail */
-
-  stream->skip();
-  if (stream->parseValue(c, filter) == EOF)
+  if (len > 0)
     {
-      deleteItem(c);
-      return NULL;
+      buffer[(size_t) length < len ? length : len - 1] = 0;
     }
-  return c;
+  return length;
 }
 
-// Render a aJsonObject item/entity/structure to text.
+// Parse a MessagePack value, the counterpart of parseValue().
 int
-aJsonClass::print(aJsonObject* item, aJsonStream* stream)
-{
-  return stream->printValue(item);
-}
-
-char*
-aJsonClass::print(aJsonObject* item)
+aJsonStream::parsePack(aJsonObject *item, char** filter, char *path)
 {
-  char* outBuf = (char*) malloc(256); /* XXX: Dynamic size. */
-  if (outBuf == NULL)
+  uint32_t size, items;
+  int type = this->readPackHeader(&size, &items);
+  if (type == EOF)
     {
-      return NULL;
+      return EOF;
     }
-  aJsonStringStream stringStream(NULL, outBuf, 256);
-  print(item, &stringStream);
-  return outBuf;
-}
-
-// Parser core - when encountering text, process appropriately.
+  if (type <= 0x7f || type >= 0xe0)
+    {
+      item->type = aJson_Int;
+      item->valueint = (signed char) type;
+      return 0;
+    }
+  if (PACK_STRING(type))
+    {
+      return this->parseString(item, size);
+    }
+  if (type <= 0x8f || type == 0xde || type == 0xdf)
+    {
+      return this->parsePackMap(item, filter, path, items / 2);
+    }
+  if (type <= 0x9f || type == 0xdc || type == 0xdd)
+    {
+      return this->parsePackArray(item, filter, path, items);
+    }
+  switch (type)
+    {
+  case 0xc0:
+    item->type = aJson_NULL;
+    return 0;
+  case 0xc2:
+    item->type = aJson_False;
+    item->valuebool = 0;
+    return 0;
+  case 0xc3:
+    item->type = aJson_True;
+    item->valuebool = -1;
+    return 0;
+  case 0xcc:
+  case 0xcd:
+  case 0xce:
+  case 0xcf:
+  case 0xd0:
+  case 0xd1:
+  case 0xd2:
+  case 0xd3:
+#if !aJson_IntegerOnly
+  case 0xca:
+  case 0xcb:
+#endif
+    return this->parsePackNumber(item, type, size);
+  default:
+    return EOF; // bin and ext have no aJson type
+    }
+}
+
+// Numbers of up to 64 bit become an int if they fit, a float otherwise.
 int
-aJsonStream::parseValue(aJsonObject *item, char** filter)
+aJsonStream::parsePackNumber(aJsonObject *item, unsigned char type,
+    unsigned char bytes)
 {
-  if (this->skip() == EOF)
+  uint32_t high = 0, low;
+  if (bytes == 8 && this->readPack(4, &high) == EOF)
     {
       return EOF;
     }
-  //read the first byte from the stream
-  int in = this->getch();
-  if (in == EOF)
+  if (this->readPack(bytes == 8 ? 4 : bytes, &low) == EOF)
     {
       return EOF;
     }
-  this->ungetch(in);
-  if (in == '\"')
+#if !aJson_IntegerOnly
+  if (type == 0xca)
     {
-      return this->parseString(item);
+      float f;
+      memcpy(&f, &low, sizeof(f));
+      item->type = aJson_Float;
+      item->valuefloat = f;
+      return 0;
     }
-  else if (in == '-' || (in >= '0' && in <= '9'))
+  if (type == 0xcb)
     {
-      return this->parseNumber(item);
+      item->type = aJson_Float;
+      item->valuefloat = unpackDouble(high, low);
+      return 0;
     }
-  else if (in == '[')
+#endif
+  if (type >= 0xd0 && bytes < 8 && ((low >> (8 * bytes - 1)) & 1))
     {
-      return this->parseArray(item, filter);
+      //sign extend to 64 bit
+      if (bytes < 4)
+        {
+          low |= 0xFFFFFFFFUL << (8 * bytes);
+        }
+      high = 0xFFFFFFFFUL;
     }
-  else if (in == '{')
+  bool negative = type >= 0xd0 && (high & 0x80000000UL);
+  if ((!negative && high == 0 && low <= INT_MAX)
+      || (negative && high == 0xFFFFFFFFUL && (low & 0x80000000UL)
+          && (int32_t) low >= INT_MIN))
     {
-      return this->parseObject(item, filter);
+      item->type = aJson_Int;
+      item->valueint = (int) (int32_t) low;
+      return 0;
     }
-  //it can only be null, false or true
-  else if (in == 'n')
+#if aJson_IntegerOnly
+  return EOF; // does not fit into an int
+#else
+  item->type = aJson_Float;
+  if (negative)
     {
-      //a buffer to read the value
-      char buffer[] =
-        { 0, 0, 0, 0 };
-      if (this->readBytes((uint8_t*) buffer, 4) != 4)
+      item->valuefloat = -((double) ~high * 4294967296.0 + (double) ~low + 1);
+    }
+  else
+    {
+      item->valuefloat = (double) high * 4294967296.0 + low;
+    }
+  return 0;
+#endif
+}
+
+int
+aJsonStream::parsePackArray(aJsonObject *item, char** filter, char *path,
+    uint32_t count)
+{
+  item->type = aJson_Array;
+  aJsonObject* child = NULL;
+  for (; count > 0; count--)
+    {
+      aJsonObject *new_item = aJsonClass::newItem();
+      if (new_item == NULL)
         {
-          return EOF;
+          return EOF; // memory fail
         }
-      if (!strncmp(buffer, "null", 4))
+      if (child == NULL)
         {
-          item->type = aJson_NULL;
-          return 0;
+          item->child = new_item;
         }
       else
+        {
+          child->next = new_item;
+          new_item->prev = child;
+        }
+      child = new_item;
+      //array items have no key, they share the path of the array
+      if (this->parsePack(child, filter, path) == EOF)
         {
           return EOF;
         }
     }
-  else if (in == 'f')
+  return 0;
+}
+
+// Same as parseObject(), keys are MessagePack strings.
+int
+aJsonStream::parsePackMap(aJsonObject *item, char** filter, char *path,
+    uint32_t count)
+{
+  item->type = aJson_Object;
+  size_t len = path ? strlen(path) : 0;
+  aJsonObject* child = NULL;
+  for (; count > 0; count--)
     {
-      //a buffer to read the value
-      char buffer[] =
-        { 0, 0, 0, 0, 0 };
-      if (this->readBytes((uint8_t*) buffer, 5) != 5)
+      uint32_t size, items;
+      int type = this->readPackHeader(&size, &items);
+      if (type == EOF || !PACK_STRING(type))
         {
-          return EOF;
+          return EOF; // keys are strings
         }
-      if (!strncmp(buffer, "false", 5))
+      bool wanted = true;
+      size_t keylen = len;
+      if (filter)
         {
-          item->type = aJson_False;
-          item->valuebool = 0;
-          return 0;
+          //read the key into the path, unwanted keys never become items
+          if (keylen > 0 && keylen < aJson_PathSize - 1)
+            {
+              path[keylen++] = '.';
+            }
+          int length = this->readPackString(path + keylen,
+              aJson_PathSize - keylen, size);
+          if (length == EOF || (size_t) length >= aJson_PathSize - keylen)
+            {
+              return EOF; // the key path does not fit, never cut
+            }
+          wanted = filterMatch(filter, path);
         }
-    }
-  else if (in == 't')
-    {
-      //a buffer to read the value
-      char buffer[] =
-        { 0, 0, 0, 0 };
-      if (this->readBytes((uint8_t*) buffer, 4) != 4)
+      if (wanted)
+        {
+          aJsonObject* new_item = aJsonClass::newItem();
+          if (new_item == NULL)
+            {
+              return EOF; // memory fail
+            }
+          if (child == NULL)
+            {
+              item->child = new_item;
+            }
+          else
+            {
+              child->next = new_item;
+              new_item->prev = child;
+            }
+          child = new_item;
+          if (filter)
+            {
+              child->name = aJsonClass::newString(path + keylen);
+              if (child->name == NULL)
+                {
+                  return EOF; // memory fail
+                }
+            }
+          else
+            {
+              if (this->parseString(child, size) == EOF)
+                {
+                  return EOF;
+                }
+              child->name = child->valuestring;
+              child->valuestring = NULL;
+            }
+          child->hash = aJsonClass::hash(child->name);
+        }
+      if ((wanted ? this->parsePack(child, filter, path) : this->skipPack())
+          == EOF)
         {
           return EOF;
         }
-      if (!strncmp(buffer, "true", 4))
+      if (path)
         {
-          item->type = aJson_True;
-          item->valuebool = -1;
-          return 0;
+          path[len] = 0;
         }
     }
-
-  return EOF; // failure.
-}
-
-// Render a value to text.
-int
-aJsonStream::printValue(aJsonObject *item)
-{
-  int result = 0;
-  if (item == NULL)
-    {
-      //nothing to do
-      return 0;
-    }
-  switch (item->type)
-    {
-  case aJson_NULL:
-    result = this->print("null");
-    break;
-  case aJson_False:
-    result = this->print("false");
-    break;
-  case aJson_True:
-    result = this->print("true");
-    break;
-  case aJson_Int:
-    result = this->printInt(item);
-    break;
-  case aJson_Float:
-    result = this->printFloat(item);
-    break;
-  case aJson_String:
-    result = this->printString(item);
-    break;
-  case aJson_Array:
-    result = this->printArray(item);
-    break;
-  case aJson_Object:
-    result = this->printObject(item);
-    break;
-    }
-  return result;
+  return 0;
 }
 
-// Build an array from input text.
+// Read over a MessagePack value, only the headers are looked at.
 int
-aJsonStream::parseArray(aJsonObject *item, char** filter)
+aJsonStream::skipPack()
 {
-  int in = this->getch();
-  if (in != '[')
+  uint32_t remaining = 1;
+  while (remaining > 0)
     {
-      return EOF; // not an array!
+      uint32_t size, items;
+      if (this->readPackHeader(&size, &items) == EOF)
+        {
+          return EOF;
+        }
+      for (; size > 0; size--)
+        {
+          if (this->getch() == EOF)
+            {
+              return EOF;
+            }
+        }
+      remaining += items - 1;
     }
+  return 0;
+}
 
-  item->type = aJson_Array;
-  this->skip();
-  in = this->getch();
-  //check for empty array
-  if (in == ']')
+// Big endian, as all numbers in MessagePack.
+void
+aJsonStream::packBytes(uint32_t value, unsigned char bytes)
+{
+  while (bytes--)
     {
-      return 0; // empty array.
+      this->write((uint8_t) (value >> (8 * bytes)));
     }
-  //now put back the last character
-  this->ungetch(in);
-  aJsonObject *child;
-  char first = -1;
-  while ((first) || (in == ','))
+}
+
+void
+aJsonStream::packHeader(unsigned char type, uint32_t value, unsigned char bytes)
+{
+  this->write(type);
+  this->packBytes(value, bytes);
+}
+
+// Smallest encoding that holds value.
+void
+aJsonStream::packInt(long value)
+{
+  if (value >= -32 && value <= 127)
     {
-      aJsonObject *new_item = aJsonClass::newItem();
-      if (new_item == NULL)
-        {
-          return EOF; // memory fail
-        }
-      if (first)
-        {
-          item->child = new_item;
-          first = 0;
-        }
+      this->write((uint8_t) value); // fixint
+    }
+  else if (value > 0)
+    {
+      if (value <= 0xFF)
+        this->packHeader(0xcc, value, 1);
+      else if (value <= 0xFFFFL)
+        this->packHeader(0xcd, value, 2);
       else
-        {
-          child->next = new_item;
-          new_item->prev = child;
-        }
-      child = new_item;
-      this->skip();
-      if (this->parseValue(child, filter))
-        {
-          return EOF;
-        }
-      this->skip();
-      in = this->getch();
+        this->packHeader(0xce, value, 4);
     }
-  if (in == ']')
+  else
     {
-      return 0; // end of array
+      if (value >= -128)
+        this->packHeader(0xd0, value, 1);
+      else if (value >= -32768L)
+        this->packHeader(0xd1, value, 2);
+      else
+        this->packHeader(0xd2, value, 4);
     }
+}
+
+void
+aJsonStream::packString(const char *string)
+{
+  size_t length = string ? strlen(string) : 0;
+  if (length < 32)
+    this->write((uint8_t) (0xa0 | length));
+  else if (length <= 0xFF)
+    this->packHeader(0xd9, length, 1);
+  else if (length <= 0xFFFFUL)
+    this->packHeader(0xda, length, 2);
   else
+    this->packHeader(0xdb, length, 4);
+  if (length)
     {
-      return EOF; // malformed.
+      this->write((const uint8_t*) string, length);
     }
 }
 
-// Render an array to text
+// Render a value as MessagePack, the counterpart of printValue().
 int
-aJsonStream::printArray(aJsonObject *item)
+aJsonStream::packValue(aJsonObject *item)
 {
   if (item == NULL)
     {
       //nothing to do
       return 0;
     }
-  aJsonObject *child = item->child;
-  if (this->print('[') == EOF)
+  switch (item->type)
     {
-      return EOF;
+  case aJson_NULL:
+    this->write(0xc0);
+    break;
+  case aJson_False:
+    this->write(0xc2);
+    break;
+  case aJson_True:
+    this->write(0xc3);
+    break;
+  case aJson_Int:
+    this->packInt(item->valueint);
+    break;
+#if !aJson_IntegerOnly
+  case aJson_Float:
+    {
+      //float 32 unless that loses precision (not on AVR, where double is a float)
+      float f = item->valuefloat;
+      if (sizeof(double) == sizeof(float) || f == item->valuefloat)
+        {
+          uint32_t bits;
+          memcpy(&bits, &f, sizeof(bits));
+          this->packHeader(0xca, bits, 4);
+        }
+      else
+        {
+          uint64_t bits;
+          memcpy(&bits, &item->valuefloat, sizeof(bits));
+          this->packHeader(0xcb, bits >> 32, 4);
+          this->packBytes(bits, 4);
+        }
     }
-  while (child)
+    break;
+#endif
+  case aJson_String:
+    this->packString(item->valuestring);
+    break;
+  case aJson_Array:
+  case aJson_Object:
     {
-      if (this->printValue(child) == EOF)
+      unsigned int count = 0;
+      aJsonObject *child;
+      for (child = item->child; child; child = child->next)
         {
-          return EOF;
+          count++;
         }
-      child = child->next;
-      if (child)
+      unsigned char type = item->type == aJson_Array ? 0x90 : 0x80;
+      if (count < 16)
+        this->write((uint8_t) (type | count)); // fixarray, fixmap
+      else
+        this->packHeader(type == 0x90 ? 0xdc : 0xde, count, 2);
+      for (child = item->child; child; child = child->next)
         {
-          if (this->print(',') == EOF)
+          if (item->type == aJson_Object)
+            {
+              this->packString(child->name);
+            }
+          if (this->packValue(child) == EOF)
             {
               return EOF;
             }
         }
     }
-  if (this->print(']') == EOF)
-    {
-      return EOF;
+    break;
     }
   return 0;
 }
 
-// Build an object from the text.
+// Parse a value and report it to the handler, nothing is allocated.
 int
-aJsonStream::parseObject(aJsonObject *item, char** filter)
+aJsonStream::parseEvents(aJsonHandler *handler)
 {
-  int in = this->getch();
-  if (in != '{')
+  //key path and string values share one buffer, the only one we need
+  char buffer[aJson_PathSize + aJson_StringSize];
+  buffer[0] = 0;
+  return this->parseEvent(handler, buffer, 0);
+}
+
+// path holds len chars, string values are decoded behind the path buffer.
+int
+aJsonStream::parseEvent(aJsonHandler *handler, char *path, size_t len)
+{
+  if (this->skip() == EOF)
     {
-      return EOF; // not an object!
+      return EOF;
     }
-
-  item->type = aJson_Object;
-  this->skip();
-  //check for an empty object
-  in = this->getch();
-  if (in == '}')
+  int in = this->getch();
+  if (in == EOF)
     {
-      return 0; // empty object.
+      return EOF;
     }
-  //preserve the char for the next parser
-  this->ungetch(in);
-
-  aJsonObject* child;
-  char first = -1;
-  while ((first) || (in == ','))
+  if (in == '{' || in == '[')
     {
-      aJsonObject* new_item = aJsonClass::newItem();
-      if (new_item == NULL)
-        {
-          return EOF; // memory fail
-        }
-      if (first)
-        {
-          first = 0;
-          item->child = new_item;
-        }
+      char end = (in == '{') ? '}' : ']';
+      if (end == '}')
+        handler->beginObject(path);
       else
-        {
-          child->next = new_item;
-          new_item->prev = child;
-        }
-      child = new_item;
-      this->skip();
-      if (this->parseString(child) == EOF)
-        {
-          return EOF;
-        }
+        handler->beginArray(path);
       this->skip();
-      child->name = child->valuestring;
-      child->valuestring = NULL;
-
       in = this->getch();
-      if (in != ':')
+      if (in != end)
         {
-          return EOF; // fail!
+          this->ungetch(in);
+          do
+            {
+              if (end == '}')
+                {
+                  //append ".key" to the path
+                  size_t keylen = len;
+                  if (keylen > 0 && keylen < aJson_PathSize - 1)
+                    {
+                      path[keylen++] = '.';
+                    }
+                  this->skip();
+                  if (this->readString(path + keylen, aJson_PathSize - keylen)
+                      == EOF)
+                    {
+                      return EOF;
+                    }
+                  this->skip();
+                  if (this->getch() != ':')
+                    {
+                      return EOF; // fail!
+                    }
+                  handler->key(path);
+                }
+              if (this->parseEvent(handler, path, strlen(path)) == EOF)
+                {
+                  return EOF;
+                }
+              path[len] = 0;
+              this->skip();
+              in = this->getch();
+            }
+          while (in == ',');
+          if (in != end)
+            {
+              return EOF; // malformed.
+            }
         }
-      // skip any spacing, get the value.
-      this->skip();
-      if (this->parseValue(child, filter) == EOF)
+      if (end == '}')
+        handler->endObject(path);
+      else
+        handler->endArray(path);
+      return 0;
+    }
+  this->ungetch(in);
+  if (in == '\"')
+    {
+      char *value = path + aJson_PathSize;
+      if (this->readString(value, aJson_StringSize) == EOF)
         {
           return EOF;
         }
-      this->skip();
-      in = this->getch();
+      handler->stringValue(path, value);
+      return 0;
     }
-
-  if (in == '}')
+  if (in >= 0x80)
     {
-      return 0; // end of array
+      return EOF; // MessagePack has no events
     }
-  else
+  //numbers and literals do not allocate, parse them into a temporary item
+  aJsonObject item;
+  if (this->parseValue(&item, NULL) == EOF)
     {
-      return EOF; // malformed.
+      return EOF;
+    }
+  switch (item.type)
+    {
+  case aJson_Int:
+    handler->intValue(path, item.valueint);
+    break;
+#if !aJson_IntegerOnly
+  case aJson_Float:
+    handler->floatValue(path, item.valuefloat);
+    break;
+#endif
+  case aJson_True:
+  case aJson_False:
+    handler->boolValue(path, item.type == aJson_True);
+    break;
+  case aJson_NULL:
+    handler->nullValue(path);
+    break;
+  default:
+    return EOF;
     }
+  return 0;
+}
+
+// Stores the values of parseEvents() into the members of a struct.
+class aJsonBinder : public aJsonHandler {
+public:
+  aJsonBinder(char *object_, const aJsonField *fields_, unsigned char count_)
+    : found(0), object(object_), fields(fields_), count(count_)
+  {
+  }
+
+  virtual void intValue(const char *path, int value)
+  {
+    number(path, value);
+  }
+
+#if !aJson_IntegerOnly
+  //numbers that do not fit into an int, whole ones fit into long fields
+  virtual void floatValue(const char *path, double value)
+  {
+    const aJsonField *field = find(path);
+    if (field && field->type == aJson_BindLong && value == (long) value)
+      {
+        number(path, (long) value);
+      }
+  }
+#endif
+
+  virtual void stringValue(const char *path, const char *value)
+  {
+    const aJsonField *field = find(path);
+    if (!field)
+      {
+        return;
+      }
+    char *member = object + field->offset;
+    if (field->type == aJson_BindChar)
+      {
+        unsigned char ch = value[0];
+        if (ch >= field->min && ch <= field->max)
+          {
+            *member = ch;
+            set(field);
+          }
+      }
+    else if (field->type == aJson_BindString && field->max > 0)
+      {
+        strncpy(member, value, field->max - 1);
+        member[field->max - 1] = 0;
+        set(field);
+      }
+  }
+
+  virtual void boolValue(const char *path, bool value)
+  {
+    const aJsonField *field = find(path);
+    if (field && field->type == aJson_BindBool)
+      {
+        *(bool*) (object + field->offset) = value;
+        set(field);
+      }
+  }
+
+  unsigned long found;
+
+private:
+  const aJsonField* find(const char *path)
+  {
+    for (unsigned char i = 0; i < count; i++)
+      {
+        if (!strcasecmp(path, fields[i].path))
+          return fields + i;
+      }
+    return NULL;
+  }
+
+  void set(const aJsonField *field)
+  {
+    found |= 1UL << (field - fields);
+  }
+
+  void number(const char *path, long value)
+  {
+    const aJsonField *field = find(path);
+    if (!field || value < field->min || value > field->max)
+      {
+        return;
+      }
+    char *member = object + field->offset;
+    switch (field->type)
+      {
+    case aJson_BindInt:
+      *(int*) member = value;
+      break;
+    case aJson_BindByte:
+      *(unsigned char*) member = value;
+      break;
+    case aJson_BindLong:
+      *(long*) member = value;
+      break;
+    default:
+      return;
+      }
+    set(field);
+  }
+
+  char *object;
+  const aJsonField *fields;
+  unsigned char count;
+};
+
+int
+aJsonStream::bind(void *object, const aJsonField *fields, unsigned char count,
+    unsigned long *found)
+{
+  aJsonBinder binder((char*) object, fields, count);
+  int result = this->parseEvents(&binder);
+  if (found)
+    {
+      *found = binder.found;
+    }
+  return result;
 }
 
 // Render an object to text.
@@ -931,12 +3158,37 @@ aJsonClass::getArrayItem(aJsonObject *array, unsigned char item)
 aJsonObject*
 aJsonClass::getObjectItem(aJsonObject *object, const char *string)
 {
+  return getObjectItemHashed(object, hash(string), string);
+}
+
+aJsonObject*
+aJsonClass::getObjectItemHashed(aJsonObject *object, unsigned char hash,
+    const char *string)
+{
+  if (object == NULL)
+    {
+      return NULL;
+    }
   aJsonObject *c = object->child;
-  while (c && strcasecmp(c->name, string))
+  while (c && (c->hash != hash || !c->name || strcasecmp(c->name, string)))
     c = c->next;
   return c;
 }
 
+// Must give the same as the aJson_Hash() macro: weights are powers of 31.
+unsigned char
+aJsonClass::hash(const char *string)
+{
+  unsigned char hash = 0;
+  unsigned char weight = 1;
+  for (unsigned char i = 0; i < aJson_HashLength && string[i]; i++)
+    {
+      hash += (string[i] | 0x20) * weight;
+      weight *= 31;
+    }
+  return hash;
+}
+
 // Utility for array list handling.
 void
 aJsonClass::suffixObject(aJsonObject *prev, aJsonObject *item)
@@ -983,8 +3235,9 @@ aJsonClass::addItemToObject(aJsonObject *object, const char *string,
   if (!item)
     return;
   if (item->name)
-    free(item->name);
-  item->name = strdup(string);
+    release(item->name);
+  item->name = newString(string);
+  item->hash = hash(string);
   addItemToArray(object, item);
 }
 void
@@ -1069,7 +3322,8 @@ aJsonClass::replaceItemInObject(aJsonObject *object, const char *string,
     i++, c = c->next;
   if (c)
     {
-      newitem->name = strdup(string);
+      newitem->name = newString(string);
+      newitem->hash = hash(string);
       replaceItemInArray(object, i, newitem);
     }
 }
@@ -1130,6 +3384,7 @@ aJsonClass::createItem(int num)
   return item;
 }
 
+#if !aJson_IntegerOnly
 aJsonObject*
 aJsonClass::createItem(double num)
 {
@@ -1141,6 +3396,7 @@ aJsonClass::createItem(double num)
     }
   return item;
 }
+#endif
 
 aJsonObject*
 aJsonClass::createItem(const char *string)
@@ -1149,7 +3405,7 @@ aJsonClass::createItem(const char *string)
   if (item)
     {
       item->type = aJson_String;
-      item->valuestring = strdup(string);
+      item->valuestring = newString(string);
     }
   return item;
 }
@@ -1189,6 +3445,7 @@ aJsonClass::createIntArray(int *numbers, unsigned char count)
   return a;
 }
 
+#if !aJson_IntegerOnly
 aJsonObject*
 aJsonClass::createFloatArray(double *numbers, unsigned char count)
 {
@@ -1222,6 +3479,7 @@ aJsonClass::createDoubleArray(double *numbers, unsigned char count)
     }
   return a;
 }
+#endif
 
 aJsonObject*
 aJsonClass::createStringArray(const char **strings, unsigned char count)
@@ -1264,11 +3522,13 @@ aJsonClass::addNumberToObject(aJsonObject* object, const char* name, int n)
   addItemToObject(object, name, createItem(n));
 }
 
+#if !aJson_IntegerOnly
 void
 aJsonClass::addNumberToObject(aJsonObject* object, const char* name, double n)
 {
   addItemToObject(object, name, createItem(n));
 }
+#endif
 
 void
 aJsonClass::addStringToObject(aJsonObject* object, const char* name,
@@ -29,6 +29,7 @@
 #include <Stream.h>
 #include <Client.h>
 #include <Arduino.h>  // To get access to the Arduino millis() function
+#include <stddef.h>  // offsetof() in aJson_Field()
 
 /******************************************************************************
  * Definitions
@@ -45,10 +46,45 @@
 
 #define aJson_IsReference 128
 
+// Set to 1 for a build without floating point: no aJson_Float items, numbers
+// with fraction or exponent are parsed to int (fraction cut off) and numbers
+// that do not fit into an int fail to parse.
+#define aJson_IntegerOnly 0
+
+// aJsonFrameStream::collect() results:
+#define aJson_FrameMore 0
+#define aJson_FrameReady 1
+
+// Key hash of aJsonObject, case-insensitive over the first aJson_HashLength chars.
+// aJson_Hash("CF") is the same as aJsonClass::hash("CF") but computed by the
+// compiler - use it with string literals only.
+#define aJson_HashLength 8
+#define aJson_HashChar(s, i, w) ((i) < sizeof(s) - 1 ? ((s)[(i) < sizeof(s) - 1 ? (i) : 0] | 0x20) * (w) : 0)
+#define aJson_Hash(s) ((unsigned char) (aJson_HashChar(s, 0, 1) \
+		+ aJson_HashChar(s, 1, 31) + aJson_HashChar(s, 2, 193) \
+		+ aJson_HashChar(s, 3, 95) + aJson_HashChar(s, 4, 129) \
+		+ aJson_HashChar(s, 5, 159) + aJson_HashChar(s, 6, 65) \
+		+ aJson_HashChar(s, 7, 223)))
+
+// Entries of aJsonTape, the type in the high 4 bits of the first word
+#define aJson_TapeSize(word) ((word) & 0x0FFF) // string length or words of object/array content
+#define aJson_TapeType(word) ((word) >> 12)
+
+// Buffers of aJsonStream::parseEvents(), both on the stack of the call
+#define aJson_PathSize 32 // longest key path + 1
+#define aJson_StringSize 64 // longest string value + 1
+
+// Longest string value or key + 1 parsed to the heap, a longer one fails the parse
+#define aJson_HeapStringSize 256
+
 #ifndef EOF
 #define EOF -1
 #endif
 
+// Allocator hook of the growing aJsonStringStream, realloc() fits:
+// returns buffer moved to size bytes, NULL if there is no memory.
+typedef void* (*aJsonGrow)(void *buffer, size_t size);
+
 // The aJson structure:
 typedef struct aJsonObject {
         char *name; // The item's name string, if this item is the child of, or is in the list of subitems of an object.
@@ -56,15 +92,72 @@ typedef struct aJsonObject {
 	struct aJsonObject *child; // An array or object item will have a child pointer pointing to a chain of the items in the array/object.
 
 	char type; // The type of the item, as above.
+	unsigned char hash; // aJsonClass::hash() of name, compared before the name itself.
 
 	union {
 		char *valuestring; // The item's string, if type==aJson_String
 		char valuebool; //the items value for true & false
 		int valueint; // The item's number, if type==aJson_Number
+#if !aJson_IntegerOnly
 		double valuefloat; // The item's number, if type==aJson_Number
+#endif
 	};
 } aJsonObject;
 
+/* Callbacks of aJsonStream::parseEvents(). path is the dotted key path
+ * of the value, e.g. "AT.V1" for {"AT":{"V1":200}}; array elements get
+ * the path of their array. Paths are cut at aJson_PathSize - 1 chars and
+ * string values at aJson_StringSize - 1 chars. path and string values are
+ * only valid during the call. Override the ones you need. */
+class aJsonHandler {
+public:
+	virtual void beginObject(const char *path) {}
+	virtual void endObject(const char *path) {}
+	virtual void beginArray(const char *path) {}
+	virtual void endArray(const char *path) {}
+	virtual void key(const char *path) {}
+	virtual void intValue(const char *path, int value) {}
+#if !aJson_IntegerOnly
+	virtual void floatValue(const char *path, double value) {}
+#endif
+	virtual void stringValue(const char *path, const char *value) {}
+	virtual void boolValue(const char *path, bool value) {}
+	virtual void nullValue(const char *path) {}
+};
+
+// Member types of aJsonField
+#define aJson_BindInt 0 // int
+#define aJson_BindByte 1 // unsigned char
+#define aJson_BindLong 2 // long
+#define aJson_BindBool 3 // bool, from true or false
+#define aJson_BindChar 4 // char, first char of a string value
+#define aJson_BindString 5 // char array, cut to its size - 1 chars
+
+/* One member of a struct bound to a key path, e.g. "AT.V1". Numbers and
+ * chars outside of min..max are rejected like values of the wrong type;
+ * for strings max is the size of the array. Declare the table once with
+ * aJson_Field() and use it both ways:
+ *
+ *   struct Speed { int v1, v2; };
+ *   const aJsonField speedFields[] = {
+ *     aJson_Field(Speed, v1, "AT.V1", Int, 50, 255),
+ *     aJson_Field(Speed, v2, "AT.V2", Int, 50, 255),
+ *   };
+ *
+ * Members of one object have to follow each other in the table. */
+typedef struct aJsonField {
+	const char *path;
+	unsigned char type;
+	unsigned char offset;
+	long min, max;
+} aJsonField;
+
+#define aJson_Field(object, member, path, type, min, max) \
+	{ path, aJson_Bind##type, offsetof(object, member), min, max }
+#define aJson_StringField(object, member, path) \
+	{ path, aJson_BindString, offsetof(object, member), 0, sizeof(((object*) 0)->member) }
+#define aJson_FieldCount(table) (sizeof(table) / sizeof(table[0]))
+
 /* aJsonStream is stream representation of aJson for its internal use;
  * it is meant to abstract out differences between Stream (e.g. serial
  * stream) and Client (which may or may not be connected) or provide even
@@ -72,7 +165,8 @@ typedef struct aJsonObject {
 class aJsonStream : public Print {
 public:
 	aJsonStream(Stream *stream_)
-		: stream_obj(stream_), bucket(EOF)
+		: stream_obj(stream_), bucket(EOF),
+		  out_buffer(NULL), out_size(0), out_len(0)
 		{}
 	/* Use this to check if more data is available, as aJsonStream
 	 * can read some more data than really consumed and automatically
@@ -81,25 +175,90 @@ public:
 
 	int parseNumber(aJsonObject *item);
 	int printInt(aJsonObject *item);
+#if !aJson_IntegerOnly
 	int printFloat(aJsonObject *item);
+#endif
 
 	int parseString(aJsonObject *item);
+	/* length is that of a MessagePack string, -1 for a JSON string. */
+	int parseString(aJsonObject *item, long length);
 	int printStringPtr(const char *str);
 	int printString(aJsonObject *item);
 
 	int skip();
 	int flush();
 
+	/* filter is NULL or a NULL terminated list of key paths like "AT.V1",
+	 * see aJsonClass::parse(). */
 	int parseValue(aJsonObject *item, char** filter);
 	int printValue(aJsonObject *item);
 
-	int parseArray(aJsonObject *item, char** filter);
+	/* path is the key path of item with room for aJson_PathSize chars,
+	 * only used (and not NULL) with a filter. */
+	int parseValue(aJsonObject *item, char** filter, char *path);
+	int parseArray(aJsonObject *item, char** filter, char *path);
 	int printArray(aJsonObject *item);
 
-	int parseObject(aJsonObject *item, char** filter);
+	int parseObject(aJsonObject *item, char** filter, char *path);
 	int printObject(aJsonObject *item);
 
+	/* Read over one value without building anything. */
+	int skipValue();
+
+	/* MessagePack: parseValue() reads a value that starts with a byte of
+	 * 0x80 or more (map, array, string or negative number) as MessagePack,
+	 * so aJson.parse() takes both. packValue() writes item as MessagePack.
+	 * bin and ext values do not parse, skipPack() reads over them too. */
+	int parsePack(aJsonObject *item, char** filter, char *path);
+	int packValue(aJsonObject *item);
+	int skipPack();
+
+	/* Collect output in buffer instead of handing every char to the
+	 * stream. send() then writes the frame out in a single write(), so
+	 * it is not split up on the way (e.g. into several BLE packets).
+	 * Output that does not fit is written in buffer sized pieces.
+	 * NULL writes every char directly again. */
+	void setOutputBuffer(char *buffer, size_t size);
+	/* Add "\r\n" and write the buffered frame. Returns the bytes of that
+	 * last write(). */
+	size_t send();
+
+	using Print::write;
+	virtual size_t write(const uint8_t *buffer, size_t size);
+
+	/* Parse one value and report it to handler as it is read, without
+	 * building objects or allocating any memory. Returns EOF on error,
+	 * the handler may already have seen parts of the value then. */
+	int parseEvents(aJsonHandler *handler);
+	/* Parse one value straight into the members of object, no objects
+	 * are built. Keys that are not in fields are skipped. Bit i of
+	 * found is set for every fields[i] that was set, count is at most
+	 * 32. Returns EOF on error, members read before it are set. */
+	int bind(void *object, const aJsonField *fields, unsigned char count,
+			unsigned long *found = NULL);
+
 protected:
+	/* Decode a string starting at its '\"' into buffer, longer strings
+	 * are cut to len - 1 chars. Returns the full length of the string
+	 * like snprintf(), so length >= len means it was cut. */
+	int readString(char *buffer, size_t len);
+	/* Same for a MessagePack string of length bytes after its header. */
+	int readPackString(char *buffer, size_t len, long length);
+	/* Read a MessagePack header, returns its type byte or EOF. size is the
+	 * bytes that follow it, items the values that follow (twice the pairs
+	 * of a map). */
+	int readPackHeader(uint32_t *size, uint32_t *items);
+	int readPack(unsigned char bytes, uint32_t *value);
+	int parsePackNumber(aJsonObject *item, unsigned char type, unsigned char bytes);
+	int parsePackArray(aJsonObject *item, char** filter, char *path, uint32_t count);
+	int parsePackMap(aJsonObject *item, char** filter, char *path, uint32_t count);
+	void packBytes(uint32_t value, unsigned char bytes);
+	void packHeader(unsigned char type, uint32_t value, unsigned char bytes);
+	void packInt(long value);
+	void packString(const char *string);
+	int parseEvent(aJsonHandler *handler, char *path, size_t len);
+	friend class aJsonTape;
+
 	/* Blocking load of character, returning EOF if the stream
 	 * is exhausted. */
 	/* Base implementation just looks at bucket, returns EOF
@@ -126,6 +285,12 @@ protected:
 	 * to be returned by next getch() - returned by a call
 	 * to ungetch(). */
 	int bucket;
+
+private:
+	size_t writeBuffer();
+
+	char *out_buffer;
+	size_t out_size, out_len;
 };
 
 /* JSON stream that consumes data from a connection (usually
@@ -143,27 +308,266 @@ private:
 	virtual inline Client *stream() { return client_obj; }
 };
 
+/* JSON stream that never blocks on input: available() moves whatever
+ * bytes the stream has into a caller-provided frame buffer and keeps
+ * its state between calls. It returns true only when a whole top-level
+ * object or array has been received; parse() then reads that frame from
+ * the buffer and sees EOF at its end. Bytes between frames are dropped.
+ * A frame starting with a MessagePack map or array header is collected
+ * until that value is complete. Output goes directly to the stream. */
+class aJsonFrameStream : public aJsonStream {
+public:
+	aJsonFrameStream(Stream *stream_, char *frame_, size_t frame_size_)
+		: aJsonStream(stream_), frame(frame_), frame_size(frame_size_)
+	{
+		reset();
+	}
+
+	virtual bool available();
+	/* Returns aJson_FrameReady when a frame is complete, aJson_FrameMore
+	 * when more input is needed, EOF if a frame overflowed the buffer
+	 * and was dropped. */
+	int collect();
+	/* Drop the current frame and any partially received one. */
+	void reset();
+	/* Length of the complete frame, 0 while there is none. The frame
+	 * can also be decoded straight from the buffer, call reset() after. */
+	size_t length() { return ready ? frame_len : 0; }
+
+private:
+	/* Reads from the complete frame only, EOF otherwise. Reading with
+	 * no frame ready (e.g. flush()) drops a partial frame. */
+	virtual int getch();
+
+	char *frame;
+	size_t frame_size, frame_len, frame_pos;
+	unsigned char depth;
+	bool in_string, escape, ready;
+	bool packed; // the frame is MessagePack
+};
+
 /* JSON stream that is bound to input and output string buffer. This is
  * for internal usage by string-based aJsonClass methods. */
-/* TODO: Elastic output buffer support. */
 class aJsonStringStream : public aJsonStream {
 public:
 	/* Either of inbuf, outbuf can be NULL if you do not care about
-	 * particular I/O direction. */
+	 * particular I/O direction. Output is cut to outbuf_len - 1 chars
+	 * and always 0 terminated. */
 	aJsonStringStream(char *inbuf_, char *outbuf_ = NULL, size_t outbuf_len_ = 0)
-		: aJsonStream(NULL), inbuf(inbuf_), outbuf(outbuf_), outbuf_len(outbuf_len_)
+		: aJsonStream(NULL), inbuf(inbuf_), outbuf(outbuf_),
+		  outbuf_len(outbuf_len_), out_count(0), grow(NULL)
 	{
 		inbuf_len = inbuf ? strlen(inbuf) : 0;
+		if (outbuf && outbuf_len)
+			*outbuf = 0;
 	}
+	/* Output only, into memory from grow() that is moved to twice its
+	 * size whenever it is full. buffer() is yours to free afterwards.
+	 * If grow() fails, the output is cut as with a fixed buffer. */
+	aJsonStringStream(aJsonGrow grow_)
+		: aJsonStream(NULL), inbuf(NULL), outbuf(NULL), inbuf_len(0),
+		  outbuf_len(0), out_count(0), grow(grow_)
+		{}
 
 	virtual bool available();
+	/* Chars written so far, including those that were cut - like the
+	 * result of snprintf(). With no output buffer nothing is stored,
+	 * so this measures the output. */
+	size_t length() { return out_count; }
+	char* buffer() { return outbuf; }
 
 private:
 	virtual int getch();
 	virtual size_t write(uint8_t ch);
 
 	char *inbuf, *outbuf;
-	size_t inbuf_len, outbuf_len;
+	size_t inbuf_len, outbuf_len, out_count;
+	aJsonGrow grow;
+};
+
+/* Writes JSON straight into a caller-provided buffer, no objects are built:
+ *
+ *   aJsonWriter out(buffer, sizeof(buffer));
+ *   out.beginObject();
+ *   out.key(F("HP"));
+ *   out.value(100);
+ *   out.endObject();
+ *   out.send(&Serial1);
+ *
+ * Commas and colons are added where they belong. Keys can be in flash (F())
+ * or in RAM. If the buffer gets too small, overflowed() turns true and
+ * send() sends nothing. */
+class aJsonWriter {
+public:
+	aJsonWriter(char *buffer_, size_t size_)
+		: buffer(buffer_), size(size_)
+	{
+		reset();
+	}
+
+	void beginObject();
+	void endObject();
+	void beginArray();
+	void endArray();
+	void key(const __FlashStringHelper *name);
+	void key(const char *name);
+	void value(int number);
+	void value(unsigned int number);
+	void value(long number);
+	void value(unsigned long number);
+	void value(bool b);
+	void value(const char *string);
+	void valueNull();
+	/* Write the members of object as a JSON object, with nested objects
+	 * from the key paths. Only fields[i] with bit i of select set are
+	 * written, count is at most 32. */
+	void emit(const void *object, const aJsonField *fields, unsigned char count,
+			unsigned long select = ~0UL);
+
+	size_t length() { return len; }
+	bool overflowed() { return overflow; }
+	/* Appends "\r\n" and hands the whole message to out in a single
+	 * write(). The writer is empty again afterwards. Returns the bytes
+	 * written, 0 if the message did not fit. */
+	size_t send(Print *out);
+	void reset();
+
+private:
+	void put(char ch);
+	void separate();
+	void string(const char *string, size_t length);
+	void key(const char *name, size_t length);
+	void number(unsigned int n, bool negative);
+	void number(unsigned long n, bool negative);
+
+	char *buffer;
+	size_t size, len;
+	bool comma; // a value was written, the next one needs a ','
+	bool overflow;
+};
+
+/* One value sent by aJsonTelemetry, the fields are its bookkeeping. */
+typedef struct aJsonTelemetryField {
+	const char *key;
+	const void *value;
+	unsigned char type; // aJson_BindInt, aJson_BindByte or aJson_BindLong
+	bool event; // sent after touch() only, not when it changes
+	bool touched;
+	unsigned int min_interval, max_interval; // ms
+	long last; // value sent last
+	unsigned long sent_at; // millis() of that
+} aJsonTelemetryField;
+
+/* Registry of values that are sent when they change, in an array of
+ * fields the caller provides:
+ *
+ *   aJsonTelemetryField fields[3];
+ *   aJsonTelemetry telemetry(fields, 3);
+ *   telemetry.add("HP", &valueHP, 100, 0); // on change, at most every 100ms
+ *   telemetry.add("BT", &battery, 1000, 10000); // and at least every 10s
+ *   int me = telemetry.addEvent("ME", &valueME); // after touch(me) only
+ *
+ * A field is due when it changed (or was touched) and its min_interval
+ * has passed since it was sent, or when max_interval has passed anyway
+ * (0 means never). write() puts the due fields into one message as long
+ * as they fit the byte budget; fields that do not fit come first in the
+ * next message. */
+class aJsonTelemetry {
+public:
+	aJsonTelemetry(aJsonTelemetryField *fields_, unsigned char size_)
+		: fields(fields_), size(size_), count(0), start(0), from(0)
+		{}
+
+	/* Returns the id of the field, EOF if the array is full. key and
+	 * value have to stay valid. */
+	int add(const char *key, const int *value, unsigned int min_interval = 0,
+			unsigned int max_interval = 0);
+	int add(const char *key, const unsigned char *value,
+			unsigned int min_interval = 0, unsigned int max_interval = 0);
+	int add(const char *key, const long *value, unsigned int min_interval = 0,
+			unsigned int max_interval = 0);
+	int addEvent(const char *key, const int *value);
+	/* Send the field even if it did not change. */
+	void touch(int id);
+
+	/* Key/value pairs of the due fields into the open object of out,
+	 * adding at most budget chars. Returns the fields written. */
+	unsigned char write(aJsonWriter *out, unsigned long now, size_t budget);
+	/* The same for other formats:
+	 *   for (int id = t.first(now); id != EOF; id = t.next(now, id)) {
+	 *     ... t.value(id) ...
+	 *     t.sent(id, now);
+	 *   } */
+	int first(unsigned long now);
+	int next(unsigned long now, int id);
+	long value(int id);
+	void sent(int id, unsigned long now);
+
+private:
+	int add(const char *key, const void *value, unsigned char type,
+			unsigned int min_interval, unsigned int max_interval, bool event);
+	bool due(unsigned char id, unsigned long now);
+
+	aJsonTelemetryField *fields;
+	unsigned char size, count;
+	unsigned char start; // the field after the last one sent
+	unsigned char from; // start of the current first()/next() round
+};
+
+/* Read-only parsed message in one array of 16-bit words instead of linked
+ * aJsonObject nodes:
+ *
+ *   uint16_t words[32];
+ *   aJsonTape msg(words, 32);
+ *   if (msg.parse(&serial_stream) != EOF) {
+ *     int at = msg.getObjectItem(msg.root(), "AT");
+ *     int v1 = msg.intValue(msg.getObjectItem(at, "V1"));
+ *   }
+ *
+ * An item is the index of its first word, EOF if there is none. Every call
+ * takes EOF too, so lookups can be chained and checked once at the end.
+ * The first word holds the type and a 12 bit size: strings store their
+ * chars inline behind it, objects and arrays store their content behind it,
+ * so an item is passed over with one jump. Numbers use the following
+ * words. An object stores its key strings each followed by the value. */
+class aJsonTape {
+public:
+	aJsonTape(uint16_t *tape_, size_t size_)
+		: tape(tape_), size(size_), len(0)
+		{}
+
+	/* Returns the root item (0), EOF if the value is malformed or does
+	 * not fit. The tape is empty then. */
+	int parse(aJsonStream *stream);
+	int parse(char *value);
+	int root() { return len ? 0 : EOF; }
+	// Words in use, e.g. to size the tape from a typical message.
+	size_t length() { return len; }
+
+	// aJson_* type of item, EOF if there is no item.
+	char getType(int item);
+	unsigned char getArraySize(int array);
+	// Array element or object value number index.
+	int getArrayItem(int array, unsigned char index);
+	// Case insensitive like aJsonClass::getObjectItem().
+	int getObjectItem(int object, const char *key);
+
+	// Values of the wrong type read as 0, NULL or false.
+	int intValue(int item);
+#if !aJson_IntegerOnly
+	double floatValue(int item);
+#endif
+	const char* stringValue(int item);
+	bool boolValue(int item);
+
+private:
+	int parseValue(aJsonStream *stream);
+	int parseString(aJsonStream *stream);
+	int put(char type, const void *value, size_t bytes);
+	size_t words(int item);
+
+	uint16_t *tape;
+	size_t size, len;
 };
 
 class aJsonClass {
@@ -177,22 +581,42 @@ class aJsonClass {
 public:
 	// Supply a block of JSON, and this returns a aJson object you can interrogate. Call aJson.deleteItem when finished.
         aJsonObject* parse(aJsonStream* stream); //Reads from a stream
-        aJsonObject* parse(aJsonStream* stream,char** filter_values); //Read from a file, but only return values include in the char* array filter_values
+        aJsonObject* parse(aJsonStream* stream,char** filter_values); //Read from a file, but only return values whose key path is in the NULL terminated array filter_values, e.g. {"AT.V1", "CF", NULL}. Everything else is skipped without allocating.
 	aJsonObject* parse(char *value); //Reads from a string
 	// Render a aJsonObject entity to text for transfer/storage. Free the char* when finished.
 	int print(aJsonObject *item, aJsonStream* stream);
-	char* print(aJsonObject* item);
+	// Same as MessagePack - parse() detects it by itself.
+	int pack(aJsonObject *item, aJsonStream* stream);
+	char* print(aJsonObject* item); // malloc()s exactly the length of the text
+	// Render into buffer like snprintf(): cut to size - 1 chars, the full length
+	// is returned, so a result >= size did not fit. print(item, NULL, 0) measures.
+	int print(aJsonObject* item, char *buffer, size_t size);
 	//Renders a aJsonObject directly to a output stream
 	char stream(aJsonObject *item, aJsonStream* stream);
 	// Delete a aJsonObject entity and all sub-entities.
 	void deleteItem(aJsonObject *c);
 
+	// Arena mode: nodes and strings are taken from buffer instead of malloc().
+	// deleteItem() does not give arena memory back, resetArena() releases
+	// everything at once - all objects from the arena are invalid afterwards.
+	// Allocation fails (NULL) when the arena is full. Pass NULL to go back to malloc().
+	void setArena(void *buffer, size_t size);
+	void resetArena();
+	// Bytes of the arena in use, e.g. to size it from a typical message.
+	size_t arenaUsed();
+
 	// Returns the number of items in an array (or object).
 	unsigned char getArraySize(aJsonObject *array);
 	// Retrieve item number "item" from array "array". Returns NULL if unsuccessful.
 	aJsonObject* getArrayItem(aJsonObject *array, unsigned char item);
 	// Get item "string" from object. Case insensitive.
 	aJsonObject* getObjectItem(aJsonObject *object, const char *string);
+	// Same with the key hash given, e.g. getObjectItemHashed(msg, aJson_Hash("CF"), "CF").
+	// Only items with the same hash are compared by name. Returns NULL if object is NULL.
+	aJsonObject* getObjectItemHashed(aJsonObject *object, unsigned char hash,
+			const char *string);
+	// Hash of a key as stored in aJsonObject.hash.
+	static unsigned char hash(const char *string);
 
 	// These calls create a aJsonObject item of the appropriate type.
 	aJsonObject* createNull();
@@ -200,15 +624,19 @@ public:
 	aJsonObject* createFalse();
 	aJsonObject* createItem(char b);
 	aJsonObject* createItem(int num);
+#if !aJson_IntegerOnly
 	aJsonObject* createItem(double num);
+#endif
 	aJsonObject* createItem(const char *string);
 	aJsonObject* createArray();
 	aJsonObject* createObject();
 
 	// These utilities create an Array of count items.
 	aJsonObject* createIntArray(int *numbers, unsigned char count);
+#if !aJson_IntegerOnly
 	aJsonObject* createFloatArray(double *numbers, unsigned char count);
 	aJsonObject* createDoubleArray(double *numbers, unsigned char count);
+#endif
 	aJsonObject* createStringArray(const char **strings, unsigned char count);
 
 	// Append item to the specified array/object.
@@ -236,13 +664,22 @@ public:
 	void addTrueToObject(aJsonObject* object, const char* name);
 	void addFalseToObject(aJsonObject* object, const char* name);
 	void addNumberToObject(aJsonObject* object, const char* name, int n);
+#if !aJson_IntegerOnly
         void addNumberToObject(aJsonObject* object, const char* name, double n);
+#endif
 	void addStringToObject(aJsonObject* object, const char* name,
 					const char* s);
 
 protected:
 	friend class aJsonStream;
 	static aJsonObject* newItem();
+	// All memory of aJson objects goes through these, arena or heap.
+	static void* alloc(size_t size);
+	// Free space at the top of the arena, NULL without arena. Data written
+	// there is kept by alloc() of its size, which returns the same pointer.
+	static char* arenaTop(size_t *size);
+	static void release(void *ptr);
+	static char* newString(const char *string);
 
 private:
 	void suffixObject(aJsonObject *prev, aJsonObject *item);
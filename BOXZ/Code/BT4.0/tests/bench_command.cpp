@@ -0,0 +1,96 @@
+/*
+bench_command.cpp - BoxzCommand against aJson.parse() and the lookups of ComExecution().
+
+ Both read every message of the recorded drive session and take CF.ME/HP/MP
+ and AT.K1/K2/V1/V2 out of it. The tree path parses into the heap and looks
+ the keys up as ComExecution() did before BoxzCommand, then deletes the
+ tree. BoxzCommand decodes the frame buffer in place. Prints ns per message.
+ */
+
+#include "bench.h"
+#include <aJSON.h>
+#include <BoxzCommand.h>
+
+#define ROUNDS		500
+
+struct Values
+{
+  int me, hp, mp, k1, k2, v1, v2;
+};
+
+static int treeItem(aJsonObject *object, const char *key, int none)
+{
+  aJsonObject *item = object ? aJson.getObjectItem(object, key) : NULL;
+  if(!item) return none;
+  return item->type == aJson_String ? item->valuestring[0] : item->valueint;
+}
+
+//ComExecution() before BoxzCommand
+static void treeValues(aJsonObject *msg, Values &values)
+{
+  aJsonObject *config = aJson.getObjectItem(msg, "CF");
+  values.me = treeItem(config, "ME", values.me);
+  values.hp = treeItem(config, "HP", values.hp);
+  values.mp = treeItem(config, "MP", values.mp);
+  aJsonObject *action = aJson.getObjectItem(msg, "AT");
+  values.k1 = treeItem(action, "K1", values.k1);
+  values.k2 = treeItem(action, "K2", values.k2);
+  values.v1 = treeItem(action, "V1", values.v1);
+  values.v2 = treeItem(action, "V2", values.v2);
+}
+
+//ComExecution() now
+static void commandValues(const BoxzCommand &cmd, Values &values)
+{
+  if(cmd.fields & BOXZ_CF_ME) values.me = cmd.me;
+  if(cmd.fields & BOXZ_CF_HP) values.hp = cmd.hp;
+  if(cmd.fields & BOXZ_CF_MP) values.mp = cmd.mp;
+  if(cmd.fields & BOXZ_AT_K1) values.k1 = cmd.k1;
+  if(cmd.fields & BOXZ_AT_K2) values.k2 = cmd.k2;
+  if(cmd.fields & BOXZ_AT_V1) values.v1 = cmd.v1;
+  if(cmd.fields & BOXZ_AT_V2) values.v2 = cmd.v2;
+}
+
+int main()
+{
+  std::vector<std::string> traffic = loadTraffic();
+  char in[256];
+  long count = 0;
+
+  Values tree = {0, 0, 0, 0, 0, 0, 0};
+  double start = benchSeconds();
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      strcpy(in, traffic[i].c_str());
+      aJsonStringStream stream(in);
+      aJsonObject *msg = aJson.parse(&stream);
+      treeValues(msg, tree);
+      aJson.deleteItem(msg);
+      count++;
+    }
+  }
+  double treeTime = benchSeconds() - start;
+
+  Values decoded = {0, 0, 0, 0, 0, 0, 0};
+  long broken = 0;
+  start = benchSeconds();
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      strcpy(in, traffic[i].c_str());
+      BoxzCommand cmd;
+      if(cmd.parse(in, traffic[i].size())) commandValues(cmd, decoded);
+      else broken++;
+    }
+  }
+  double commandTime = benchSeconds() - start;
+
+  if(broken || memcmp(&tree, &decoded, sizeof(tree))){
+    printf("bench_command: the two paths read different values\n");
+    return 1;
+  }
+  benchSink = decoded.v1;
+  printf("bench_command: %zu messages x %d\n", traffic.size(), ROUNDS);
+  printf("  aJson.parse + lookups   %6.0f ns/msg\n", treeTime * 1e9 / count);
+  printf("  BoxzCommand::parse()    %6.0f ns/msg\n", commandTime * 1e9 / count);
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+bench_events.cpp - aJsonStream::parseEvents() against the aJsonObject tree.
+
+ Both read every message of the recorded drive session and take CF.ME/HP/MP
+ and AT.K1/K2/V1/V2 out of it. The tree path parses into the heap, looks
+ the keys up and deletes the tree, as ComExecution() did before. Prints
+ messages per second and the heap bytes a message holds at its peak.
+ */
+
+#include "bench.h"
+#include <aJSON.h>
+
+#define ROUNDS		500
+
+struct Values
+{
+  int me, hp, mp, k1, k2, v1, v2;
+};
+
+static long heapBefore, heapPeak;
+static bool measure; //heap figures in the first round only, they are slow
+
+class ValueHandler : public aJsonHandler
+{
+public:
+  Values values;
+
+  virtual void intValue(const char *path, int value)
+  {
+    if(!strcmp(path, "CF.ME")) values.me = value;
+    else if(!strcmp(path, "CF.HP")) values.hp = value;
+    else if(!strcmp(path, "CF.MP")) values.mp = value;
+    else if(!strcmp(path, "AT.V1")) values.v1 = value;
+    else if(!strcmp(path, "AT.V2")) values.v2 = value;
+    peak();
+  }
+  virtual void stringValue(const char *path, const char *value)
+  {
+    if(!strcmp(path, "AT.K1")) values.k1 = value[0];
+    else if(!strcmp(path, "AT.K2")) values.k2 = value[0];
+    peak();
+  }
+
+private:
+  void peak()
+  {
+    if(!measure) return;
+    long used = HEAP_IN_USE() - heapBefore;
+    if(used > heapPeak) heapPeak = used;
+  }
+};
+
+static int intItem(aJsonObject *object, const char *key, int none)
+{
+  aJsonObject *item = object ? aJson.getObjectItem(object, key) : NULL;
+  if(!item) return none;
+  return item->type == aJson_String ? item->valuestring[0] : item->valueint;
+}
+
+static void treeValues(aJsonObject *msg, Values &values)
+{
+  aJsonObject *config = aJson.getObjectItem(msg, "CF");
+  values.me = intItem(config, "ME", values.me);
+  values.hp = intItem(config, "HP", values.hp);
+  values.mp = intItem(config, "MP", values.mp);
+  aJsonObject *action = aJson.getObjectItem(msg, "AT");
+  values.k1 = intItem(action, "K1", values.k1);
+  values.k2 = intItem(action, "K2", values.k2);
+  values.v1 = intItem(action, "V1", values.v1);
+  values.v2 = intItem(action, "V2", values.v2);
+}
+
+int main()
+{
+  std::vector<std::string> traffic = loadTraffic();
+  char in[256];
+  long count = 0;
+
+  Values tree = {0, 0, 0, 0, 0, 0, 0};
+  long treePeak = 0;
+  double start = benchSeconds();
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      strcpy(in, traffic[i].c_str());
+      aJsonStringStream stream(in);
+      long before = round == 0 ? HEAP_IN_USE() : 0;
+      aJsonObject *msg = aJson.parse(&stream);
+      if(round == 0 && HEAP_IN_USE() - before > treePeak) treePeak = HEAP_IN_USE() - before;
+      treeValues(msg, tree);
+      aJson.deleteItem(msg);
+      count++;
+    }
+  }
+  double treeTime = benchSeconds() - start;
+
+  ValueHandler handler;
+  memset(&handler.values, 0, sizeof(handler.values));
+  heapPeak = 0;
+  start = benchSeconds();
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      strcpy(in, traffic[i].c_str());
+      aJsonStringStream stream(in);
+      measure = round == 0;
+      if(measure) heapBefore = HEAP_IN_USE();
+      stream.parseEvents(&handler);
+    }
+  }
+  double eventTime = benchSeconds() - start;
+
+  if(memcmp(&tree, &handler.values, sizeof(tree))){
+    printf("bench_events: the two paths read different values\n");
+    return 1;
+  }
+  benchSink = tree.v1;
+  printf("bench_events: %zu messages x %d\n", traffic.size(), ROUNDS);
+  printf("  aJson.parse + lookups   %9.0f msg/s  %5ld heap bytes/msg peak\n", count / treeTime, treePeak);
+  printf("  parseEvents             %9.0f msg/s  %5ld heap bytes/msg peak\n", count / eventTime, heapPeak);
+  return 0;
+}
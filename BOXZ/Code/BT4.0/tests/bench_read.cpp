@@ -0,0 +1,99 @@
+/*
+bench_read.cpp - Reading input through aJsonStream::getch(), before and after.
+
+ Every message of the recorded drive session is parsed from a Stream that
+ counts its calls. The old getch() asked available() and millis() for every
+ char before read(), PollingStream below does the same. The current getch()
+ reads first and only waits when read() has nothing. Prints ns per byte and
+ the Stream and millis() calls per byte of both, host.cpp counts millis().
+ */
+
+#include "bench.h"
+#include "test.h"
+#include <aJSON.h>
+
+#define ROUNDS		500
+
+static long calls;
+
+class CountingStream : public TestStream
+{
+public:
+  virtual int available() { calls++; return TestStream::available(); }
+  virtual int read() { calls++; return TestStream::read(); }
+  virtual int peek() { calls++; return TestStream::peek(); }
+};
+
+//getch() as it was before, a wait on available() for every char
+class PollingStream : public aJsonStream
+{
+public:
+  PollingStream(Stream *stream_) : aJsonStream(stream_) {}
+
+private:
+  virtual int getch()
+  {
+    if (bucket != EOF)
+      {
+        int ret = bucket;
+        bucket = EOF;
+        return ret;
+      }
+    unsigned long i= millis()+500;
+    while ((!stream()->available()) && (millis() < i)) ;
+    return stream()->read();
+  }
+};
+
+//parses all messages ROUNDS times, returns the seconds taken
+template <class S>
+static double parseAll(const std::vector<std::string> &traffic, long &sum)
+{
+  CountingStream serial;
+  serial.in.reserve(256);
+  double start = benchSeconds();
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      serial.in = traffic[i];
+      serial.pos = 0;
+      S stream(&serial);
+      aJsonObject *msg = aJson.parse(&stream);
+      aJsonObject *action = msg ? aJson.getObjectItem(msg, "AT") : NULL;
+      aJsonObject *v1 = action ? aJson.getObjectItem(action, "V1") : NULL;
+      if(v1) sum += v1->valueint;
+      aJson.deleteItem(msg);
+    }
+  }
+  return benchSeconds() - start;
+}
+
+int main()
+{
+  std::vector<std::string> traffic = loadTraffic();
+  long bytes = 0;
+  for(size_t i = 0; i < traffic.size(); i++) bytes += traffic[i].size();
+  bytes *= ROUNDS;
+
+  long pollSum = 0, readSum = 0;
+  calls = 0;
+  hostMillisCalls = 0;
+  double pollTime = parseAll<PollingStream>(traffic, pollSum);
+  long pollCalls = calls, pollClock = hostMillisCalls;
+
+  calls = 0;
+  hostMillisCalls = 0;
+  double readTime = parseAll<aJsonStream>(traffic, readSum);
+  long readCalls = calls, readClock = hostMillisCalls;
+
+  if(pollSum != readSum){
+    printf("bench_read: the two getch() read different values\n");
+    return 1;
+  }
+  benchSink = readSum;
+  printf("bench_read: %zu messages x %d, %ld bytes\n", traffic.size(), ROUNDS, bytes);
+  printf("  available() + read()    %6.1f ns/byte  %4.2f Stream calls/byte  %4.2f millis()/byte\n",
+    pollTime * 1e9 / bytes, (double) pollCalls / bytes, (double) pollClock / bytes);
+  printf("  read() first            %6.1f ns/byte  %4.2f Stream calls/byte  %4.2f millis()/byte\n",
+    readTime * 1e9 / bytes, (double) readCalls / bytes, (double) readClock / bytes);
+  return 0;
+}
@@ -0,0 +1,122 @@
+/*
+bench_tape.cpp - aJsonTape against the aJsonObject tree.
+
+ Every message of the recorded drive session is parsed once into an arena
+ tree and once onto a tape, then CF.ME/HP/MP and AT.K1/K2/V1/V2 are looked
+ up on both. Prints the largest message in bytes of arena and of tape, the
+ parse speed and the lookup speed of the seven keys. The arena figure is for
+ 64-bit pointers, an AVR needs about half of it.
+ */
+
+#include "bench.h"
+#include <aJSON.h>
+
+#define ROUNDS		500
+#define LOOKUPS		20	// lookup rounds per parse, to time them apart
+
+struct Values
+{
+  int me, hp, mp, k1, k2, v1, v2;
+};
+
+static int treeItem(aJsonObject *object, const char *key, int none)
+{
+  aJsonObject *item = object ? aJson.getObjectItem(object, key) : NULL;
+  if(!item) return none;
+  return item->type == aJson_String ? item->valuestring[0] : item->valueint;
+}
+
+static void treeValues(aJsonObject *msg, Values &values)
+{
+  aJsonObject *config = aJson.getObjectItem(msg, "CF");
+  values.me = treeItem(config, "ME", values.me);
+  values.hp = treeItem(config, "HP", values.hp);
+  values.mp = treeItem(config, "MP", values.mp);
+  aJsonObject *action = aJson.getObjectItem(msg, "AT");
+  values.k1 = treeItem(action, "K1", values.k1);
+  values.k2 = treeItem(action, "K2", values.k2);
+  values.v1 = treeItem(action, "V1", values.v1);
+  values.v2 = treeItem(action, "V2", values.v2);
+}
+
+static int tapeItem(aJsonTape &tape, int object, const char *key, int none)
+{
+  int item = tape.getObjectItem(object, key);
+  if(item == EOF) return none;
+  return tape.getType(item) == aJson_String ? tape.stringValue(item)[0] : tape.intValue(item);
+}
+
+static void tapeValues(aJsonTape &tape, Values &values)
+{
+  int config = tape.getObjectItem(tape.root(), "CF");
+  values.me = tapeItem(tape, config, "ME", values.me);
+  values.hp = tapeItem(tape, config, "HP", values.hp);
+  values.mp = tapeItem(tape, config, "MP", values.mp);
+  int action = tape.getObjectItem(tape.root(), "AT");
+  values.k1 = tapeItem(tape, action, "K1", values.k1);
+  values.k2 = tapeItem(tape, action, "K2", values.k2);
+  values.v1 = tapeItem(tape, action, "V1", values.v1);
+  values.v2 = tapeItem(tape, action, "V2", values.v2);
+}
+
+int main()
+{
+  std::vector<std::string> traffic = loadTraffic();
+  char in[256];
+  long count = 0;
+  static char arena[2048];
+  uint16_t words[64];
+
+  Values tree = {0, 0, 0, 0, 0, 0, 0};
+  size_t treePeak = 0;
+  double parseTime = 0, lookupTime = 0;
+  aJson.setArena(arena, sizeof(arena));
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      strcpy(in, traffic[i].c_str());
+      aJson.resetArena();
+      double start = benchSeconds();
+      aJsonObject *msg = aJson.parse(in);
+      double parsed = benchSeconds();
+      for(int lookup = 0; lookup < LOOKUPS; lookup++) treeValues(msg, tree);
+      lookupTime += benchSeconds() - parsed;
+      parseTime += parsed - start;
+      if(aJson.arenaUsed() > treePeak) treePeak = aJson.arenaUsed();
+      count++;
+    }
+  }
+  aJson.setArena(NULL, 0);
+  double treeParse = parseTime, treeLookup = lookupTime;
+
+  Values onTape = {0, 0, 0, 0, 0, 0, 0};
+  size_t tapePeak = 0;
+  parseTime = lookupTime = 0;
+  for(int round = 0; round < ROUNDS; round++){
+    for(size_t i = 0; i < traffic.size(); i++){
+      strcpy(in, traffic[i].c_str());
+      aJsonTape tape(words, sizeof(words) / sizeof(words[0]));
+      double start = benchSeconds();
+      if(tape.parse(in) == EOF){
+        printf("bench_tape: message %zu does not fit the tape\n", i);
+        return 1;
+      }
+      double parsed = benchSeconds();
+      for(int lookup = 0; lookup < LOOKUPS; lookup++) tapeValues(tape, onTape);
+      lookupTime += benchSeconds() - parsed;
+      parseTime += parsed - start;
+      if(tape.length() * sizeof(words[0]) > tapePeak) tapePeak = tape.length() * sizeof(words[0]);
+    }
+  }
+
+  if(memcmp(&tree, &onTape, sizeof(tree))){
+    printf("bench_tape: the tree and the tape read different values\n");
+    return 1;
+  }
+  benchSink = tree.v1;
+  printf("bench_tape: %zu messages x %d\n", traffic.size(), ROUNDS);
+  printf("  aJsonObject tree  %4zu bytes of arena max  parse %6.0f ns/msg  7 lookups %5.0f ns\n",
+    treePeak, treeParse * 1e9 / count, treeLookup * 1e9 / count / LOOKUPS);
+  printf("  aJsonTape         %4zu bytes of tape max   parse %6.0f ns/msg  7 lookups %5.0f ns\n",
+    tapePeak, parseTime * 1e9 / count, lookupTime * 1e9 / count / LOOKUPS);
+  return 0;
+}
@@ -0,0 +1,42 @@
+/*
+Arduino.h - Stand-in of the Arduino core for the host tests of BOXZ.
+ Only what aJSON and the hardware free parts of the BOXZ lib use.
+ */
+
+#ifndef __HOST_ARDUINO_H__
+#define __HOST_ARDUINO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+
+#define ARDUINO_HOST	1
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define lowByte(w)		((uint8_t) ((w) & 0xff))
+#define highByte(w)		((uint8_t) ((w) >> 8))
+#define bitRead(value, bit)	(((value) >> (bit)) & 0x01)
+#define bitSet(value, bit)	((value) |= (1UL << (bit)))
+#define bitClear(value, bit)	((value) &= ~(1UL << (bit)))
+#define constrain(amt, low, high)	((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+template<class T> const T& min(const T &a, const T &b) { return b < a ? b : a; }
+template<class T> const T& max(const T &a, const T &b) { return a < b ? b : a; }
+
+//the clock of the tests, host.cpp counts it from the start
+unsigned long millis(void);
+extern unsigned long hostMillisCalls; //calls of millis() so far, for the benchmarks
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+#include "Print.h"
+#include "Stream.h"
+
+#define F(s)	((const __FlashStringHelper *) (s))
+
+#endif
@@ -0,0 +1,17 @@
+/*
+Client.h - Stand-in of the Arduino Client class for the host tests of BOXZ.
+ */
+
+#ifndef __HOST_CLIENT_H__
+#define __HOST_CLIENT_H__
+
+#include "Stream.h"
+
+class Client : public Stream
+{
+public:
+  virtual uint8_t connected() = 0;
+  virtual void stop() = 0;
+};
+
+#endif
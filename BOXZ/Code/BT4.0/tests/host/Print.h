@@ -0,0 +1,37 @@
+/*
+Print.h - Stand-in of the Arduino Print class for the host tests of BOXZ.
+ */
+
+#ifndef __HOST_PRINT_H__
+#define __HOST_PRINT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define DEC 10
+#define HEX 16
+
+class __FlashStringHelper;
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t ch) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return write((const uint8_t *) str, strlen(str)); }
+
+  size_t print(const __FlashStringHelper *str) { return write((const char *) str); }
+  size_t print(const char *str) { return write(str); }
+  size_t print(char ch) { return write((uint8_t) ch); }
+  size_t print(int n, int base = DEC);
+  size_t print(unsigned int n, int base = DEC);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+  size_t println();
+  size_t println(const char *str) { return print(str) + println(); }
+};
+
+#endif
@@ -0,0 +1,20 @@
+/*
+Stream.h - Stand-in of the Arduino Stream class for the host tests of BOXZ.
+ */
+
+#ifndef __HOST_STREAM_H__
+#define __HOST_STREAM_H__
+
+#include "Print.h"
+
+class Stream : public Print
+{
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  size_t readBytes(char *buffer, size_t length);
+};
+
+#endif
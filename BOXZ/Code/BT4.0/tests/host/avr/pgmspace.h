@@ -0,0 +1,23 @@
+/*
+avr/pgmspace.h - Flash is ordinary memory on the host.
+ */
+
+#ifndef __HOST_PGMSPACE_H__
+#define __HOST_PGMSPACE_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+#define PROGMEM
+#define PGM_P			const char *
+#define PSTR(s)			(s)
+#define pgm_read_byte(p)	(*(const uint8_t *) (p))
+#define pgm_read_word(p)	(*(const uint16_t *) (p))
+#define strlen_P		strlen
+#define memcpy_P		memcpy
+#define strcmp_P		strcmp
+#define strcasecmp_P		strcasecmp
+typedef char prog_char;
+
+#endif
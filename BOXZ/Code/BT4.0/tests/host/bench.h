@@ -0,0 +1,48 @@
+/*
+bench.h - Recorded app traffic, a clock and heap figures for the host benchmarks of BOXZ.
+ */
+
+#ifndef __HOST_BENCH_H__
+#define __HOST_BENCH_H__
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#define HEAP_IN_USE()	((long) mallinfo2().uordblks)
+#else
+#define HEAP_IN_USE()	0L
+#endif
+
+//one message per line, the way the app sends them; run.sh starts in tests/
+static std::vector<std::string> loadTraffic(const char *path = "traffic/drive_session.txt")
+{
+  std::vector<std::string> messages;
+  FILE *file = fopen(path, "r");
+  if(!file){
+    perror(path);
+    exit(1);
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), file)){
+    size_t len = strcspn(line, "\r\n");
+    if(len) messages.push_back(std::string(line, len));
+  }
+  fclose(file);
+  return messages;
+}
+
+static double benchSeconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+//keeps the optimizer from dropping results
+static volatile long benchSink;
+
+#endif
@@ -0,0 +1,90 @@
+/*
+host.cpp - Arduino core functions of the host tests of BOXZ.
+ */
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <time.h>
+
+static unsigned long long hostMicros()
+{
+  static unsigned long long start = 0;
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  unsigned long long us = now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+  if(start == 0) start = us;
+  return us - start;
+}
+
+unsigned long hostMillisCalls = 0;
+
+unsigned long millis(void)
+{
+  hostMillisCalls++;
+  return hostMicros() / 1000;
+}
+
+unsigned long micros(void)
+{
+  return hostMicros();
+}
+
+void delay(unsigned long ms)
+{
+  unsigned long start = millis();
+  while(millis() - start < ms);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+  size_t n = 0;
+  while(size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::print(int n, int base)
+{
+  return print((long) n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+  return print((unsigned long) n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lx" : "%ld", n);
+  return write(text);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  char text[24];
+  snprintf(text, sizeof(text), base == HEX ? "%lx" : "%lu", n);
+  return write(text);
+}
+
+size_t Print::print(double n, int digits)
+{
+  char text[40];
+  snprintf(text, sizeof(text), "%.*f", digits, n);
+  return write(text);
+}
+
+size_t Print::println()
+{
+  return write("\r\n");
+}
+
+size_t Stream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while(count < length){
+    int ch = read();
+    if(ch < 0) break;
+    buffer[count++] = (char) ch;
+  }
+  return count;
+}
@@ -0,0 +1,44 @@
+/*
+test.h - Checks and a scripted Stream for the host tests of BOXZ.
+ */
+
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string>
+
+static int testFailures = 0;
+
+#define CHECK(cond) do { if(!(cond)){ \
+  printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+  testFailures++; } } while(0)
+
+//exit code of main()
+static inline int testResult(const char *name)
+{
+  printf("%s: %s\n", name, testFailures ? "FAILED" : "ok");
+  return testFailures ? 1 : 0;
+}
+
+//Stream over a string, bytes are appended with feed() as they would arrive
+class TestStream : public Stream
+{
+public:
+  std::string in, out;
+  size_t pos;
+
+  TestStream() : pos(0) {}
+  void feed(const char *bytes) { in += bytes; }
+  void feed(const char *bytes, size_t size) { in.append(bytes, size); }
+  void feed(const std::string &bytes) { in += bytes; }
+  virtual int available() { return in.size() - pos; }
+  virtual int read() { return pos < in.size() ? (unsigned char) in[pos++] : -1; }
+  virtual int peek() { return pos < in.size() ? (unsigned char) in[pos] : -1; }
+  virtual void flush() {}
+  virtual size_t write(uint8_t ch) { out += (char) ch; return 1; }
+  using Print::write;
+};
+
+#endif
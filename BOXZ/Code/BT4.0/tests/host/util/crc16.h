@@ -0,0 +1,17 @@
+/*
+util/crc16.h - The CRC of avr-libc used by BFrame, same result on the host.
+ */
+
+#ifndef __HOST_CRC16_H__
+#define __HOST_CRC16_H__
+
+#include <stdint.h>
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+  crc ^= data;
+  for(uint8_t i = 0; i < 8; i++) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  return crc;
+}
+
+#endif
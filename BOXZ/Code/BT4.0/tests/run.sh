@@ -0,0 +1,29 @@
+#!/bin/sh
+# Host tests of the BT4.0 libraries, run from anywhere:
+#
+#   sh tests/run.sh          every test_*.cpp, stops at the first failure
+#   sh tests/run.sh bench    every bench_*.cpp, optimized, prints the figures
+#
+# aJSON and the hardware free parts of the BOXZ lib(BoxzCommand, BFrame) are
+# built with the Arduino stand-ins in host/. Needs g++ only.
+
+T=$(cd "$(dirname "$0")" && pwd)
+L=$T/../lib
+OUT=${TMPDIR:-/tmp}/boxz-tests
+mkdir -p "$OUT" || exit 1
+
+PREFIX=test
+FLAGS="-g -O1"
+if [ "$1" = bench ]; then
+  PREFIX=bench
+  FLAGS="-O2"
+fi
+
+SOURCES="$L/aJSON/aJSON.cpp $L/BOXZ/BoxzCommand.cpp $L/BOXZ/BFrame.cpp $T/host/host.cpp"
+for test in "$T"/${PREFIX}_*.cpp; do
+  [ -f "$test" ] || continue
+  name=$(basename "$test" .cpp)
+  g++ -std=gnu++98 $FLAGS -Wall -Wno-sign-compare -DARDUINO=105 \
+    -I"$T/host" -I"$L/aJSON" -I"$L/BOXZ" $SOURCES "$test" -o "$OUT/$name" || exit 1
+  (cd "$T" && "$OUT/$name") || exit 1
+done
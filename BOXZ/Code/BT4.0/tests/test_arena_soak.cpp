@@ -0,0 +1,86 @@
+/*
+test_arena_soak.cpp - Hours of play in arena mode leave the heap untouched.
+
+ 200000 packets of two frames(almost 3 hours of commands at 20 per second),
+ of changing size, are parsed from an aJsonFrameStream into the arena and
+ each is answered with a built object, then the arena is reset. The heap must not grow by a byte
+ and the arena must be as empty after every message as before the first.
+ */
+
+#include "test.h"
+#include <aJSON.h>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#define HEAP_IN_USE()	(mallinfo2().uordblks)
+#endif
+
+#define PACKETS		200000L
+
+static char arena[512];
+static char frame[96];
+
+int main()
+{
+  static const char *messages[] = {
+    "{\"AT\":{\"K1\":\"w\",\"V1\":200,\"V2\":120}}",
+    "{\"CF\":{\"ME\":4,\"HP\":100,\"MP\":9}}",
+    "[1,2,\"three\",{\"a\":[true,false,null]}]",
+  };
+  TestStream serial;
+  aJsonFrameStream stream(&serial, frame, sizeof(frame));
+  aJson.setArena(arena, sizeof(arena));
+  size_t empty = aJson.arenaUsed();
+  size_t peak = 0;
+  long parsed = 0;
+  serial.in.reserve(256); //the test itself does not allocate in the loop
+  printf("arena soak, %ld packets\n", PACKETS); //nor stdout
+#ifdef HEAP_IN_USE
+  size_t heap = HEAP_IN_USE();
+#endif
+
+  for(long i = 0; i < PACKETS; i++){
+    //a string of 0 to 39 chars, so no two messages in a row have the same size
+    char text[64];
+    snprintf(text, sizeof(text), "{\"ID\":\"%.*s\"}", (int) (i * 7 % 40), "0123456789012345678901234567890123456789");
+    serial.in = messages[i % 3];
+    serial.in += text;
+    serial.pos = 0;
+
+    for(int part = 0; part < 2; part++){
+      CHECK(stream.available());
+      aJsonObject *msg = aJson.parse(&stream);
+      if(msg) parsed++;
+      aJsonObject *answer = aJson.createObject();
+      aJson.addNumberToObject(answer, "HP", (int) (i & 255));
+      aJson.addStringToObject(answer, "ID", text);
+      if(aJson.arenaUsed() > peak) peak = aJson.arenaUsed();
+      aJson.resetArena();
+      if(aJson.arenaUsed() != empty){
+        CHECK(aJson.arenaUsed() == empty);
+        break;
+      }
+    }
+  }
+  CHECK(parsed == 2 * PACKETS);
+  CHECK(peak < sizeof(arena));
+#ifdef HEAP_IN_USE
+  CHECK(HEAP_IN_USE() == heap);
+  printf("heap in use before %zu after %zu bytes\n", heap, (size_t) HEAP_IN_USE());
+#endif
+  printf("%ld frames, arena peak %zu of %zu bytes\n", parsed, peak, sizeof(arena));
+
+  //a full arena fails the parse, it does not fall back to the heap
+  static char tiny[40];
+  aJson.setArena(tiny, sizeof(tiny));
+  serial.in = messages[0];
+  serial.pos = 0;
+  CHECK(stream.available());
+  CHECK(aJson.parse(&stream) == NULL);
+  aJson.resetArena();
+  CHECK(aJson.arenaUsed() == empty);
+#ifdef HEAP_IN_USE
+  CHECK(HEAP_IN_USE() == heap);
+#endif
+  aJson.setArena(NULL, 0);
+  return testResult("test_arena_soak");
+}
@@ -0,0 +1,59 @@
+/*
+test_command.cpp - BoxzCommand keeps nothing of a malformed frame.
+
+ A frame that breaks after some fields were read must come back false with
+ no groups and no fields, so the sketches cannot drive the motors from half
+ a command. Good frames still set their fields.
+ */
+
+#include "test.h"
+#include <BoxzCommand.h>
+
+static boolean parse(BoxzCommand &cmd, const char *frame)
+{
+  return cmd.parse(frame, strlen(frame));
+}
+
+int main()
+{
+  BoxzCommand cmd;
+
+  CHECK(parse(cmd, "{\"AT\":{\"K1\":\"w\",\"V1\":200,\"V2\":150}}"));
+  CHECK(cmd.groups == BOXZ_AT);
+  CHECK(cmd.fields == (BOXZ_AT_K1 | BOXZ_AT_V1 | BOXZ_AT_V2));
+  CHECK(cmd.k1 == 'w' && cmd.v1 == 200 && cmd.v2 == 150);
+
+  //broken after K1 and V1 were read
+  CHECK(!parse(cmd, "{\"AT\":{\"K1\":\"w\",\"V1\":200,\"V2\":"));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+  CHECK(!parse(cmd, "{\"CF\":{\"ME\":1},\"AT\":{\"K1\":\"w\"}"));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+  CHECK(!parse(cmd, "{\"AT\":{\"K1\":\"w\"}x"));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+  CHECK(!parse(cmd, "   "));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+
+  //MessagePack {"AT":{"V1":200,"V2":150}} cut after V1
+  const char pack[] = "\x81\xA2" "AT" "\x82\xA2" "V1" "\xCC\xC8\xA2" "V2" "\xCC\x96";
+  CHECK(cmd.parse(pack, sizeof(pack) - 1));
+  CHECK(cmd.fields == (BOXZ_AT_V1 | BOXZ_AT_V2) && cmd.v2 == 150);
+  CHECK(!cmd.parse(pack, sizeof(pack) - 5));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+
+  //str8 header of the value cut off, the byte behind the frame is no value
+  const char cut[] = "\x81\xA2" "CF" "\x81\xA2" "ME" "\xD9" "\x00";
+  CHECK(!cmd.parse(cut, sizeof(cut) - 2));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+  const char cutMap[] = "\x81\xA2" "CF" "\x81\xA2" "ME" "\xDE\x00" "\x00";
+  CHECK(!cmd.parse(cutMap, sizeof(cutMap) - 2));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+
+  //binary payload: fields bits, then V1 and V2, the last value missing
+  const uint8_t payload[] = {BOXZ_AT_V1 | BOXZ_AT_V2, 200, 150};
+  CHECK(cmd.parseBinary(payload, sizeof(payload)));
+  CHECK(cmd.groups == BOXZ_AT && cmd.v1 == 200 && cmd.v2 == 150);
+  CHECK(!cmd.parseBinary(payload, sizeof(payload) - 1));
+  CHECK(cmd.groups == 0 && cmd.fields == 0);
+
+  return testResult("test_command");
+}
@@ -0,0 +1,56 @@
+/*
+test_filter_keys.cpp - A filtered parse fails on a key path that does not fit.
+
+ With a filter every key is read into a path of aJson_PathSize chars. A key
+ that does not fit must fail the parse, it is never cut and then matched or
+ stored under the cut name. Without a filter the key is kept whole.
+ */
+
+#include "test.h"
+#include <aJSON.h>
+
+static char *filter[] = {(char *) "CF", NULL};
+
+static aJsonObject *parseText(const std::string &text, char **filter_values)
+{
+  static char in[256];
+  strcpy(in, text.c_str());
+  aJsonStringStream stream(in);
+  return filter_values ? aJson.parse(&stream, filter_values) : aJson.parse(&stream);
+}
+
+static std::string packKey(const std::string &key)
+{
+  std::string pack("\x81\xA2" "CF" "\x81\xD9", 6); //str 8 key
+  pack += (char) key.size();
+  return pack + key + '\x01';
+}
+
+int main()
+{
+  const std::string longKey = "a_rather_long_configuration_key_name";
+  const std::string fits(aJson_PathSize - 1 - 3, 'k'); //"CF." and the key fill the path
+
+  CHECK(parseText("{\"CF\":{\"" + longKey + "\":1}}", filter) == NULL);
+  CHECK(parseText(packKey(longKey), filter) == NULL);
+  CHECK(parseText("{\"" + longKey + "\":1}", filter) == NULL); //skipped keys too
+
+  aJsonObject *msg = parseText("{\"CF\":{\"" + fits + "\":1}}", filter);
+  CHECK(msg != NULL);
+  aJsonObject *item = msg ? aJson.getObjectItem(aJson.getObjectItem(msg, "CF"), fits.c_str()) : NULL;
+  CHECK(item && item->valueint == 1);
+  aJson.deleteItem(msg);
+
+  msg = parseText(packKey(fits), filter);
+  item = msg ? aJson.getObjectItem(aJson.getObjectItem(msg, "CF"), fits.c_str()) : NULL;
+  CHECK(item && item->valueint == 1);
+  aJson.deleteItem(msg);
+
+  //without a filter the name is kept whole
+  msg = parseText("{\"CF\":{\"" + longKey + "\":1}}", NULL);
+  item = msg ? aJson.getObjectItem(aJson.getObjectItem(msg, "CF"), longKey.c_str()) : NULL;
+  CHECK(item && !strcmp(item->name, longKey.c_str()));
+  aJson.deleteItem(msg);
+
+  return testResult("test_filter_keys");
+}
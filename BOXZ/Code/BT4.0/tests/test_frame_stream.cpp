@@ -0,0 +1,145 @@
+/*
+test_frame_stream.cpp - aJsonFrameStream collects frames without blocking.
+
+ The input arrives one byte per available() call, as from a BLE link that
+ splits messages. available() must be false until a frame is complete and
+ parse() must see exactly that frame.
+ */
+
+#include "test.h"
+#include <aJSON.h>
+
+static char frame[64];
+
+//feed bytes one by one, returns the number of available() calls that were true
+static int feedBytes(TestStream &serial, aJsonFrameStream &stream, const std::string &bytes)
+{
+  int ready = 0;
+  for(size_t i = 0; i < bytes.size(); i++){
+    serial.feed(bytes.data() + i, 1);
+    if(stream.available()){
+      ready++;
+      CHECK(i == bytes.size() - 1); //only at the last byte of a frame
+    }
+  }
+  return ready;
+}
+
+static int itemInt(aJsonObject *msg, const char *group, const char *key)
+{
+  aJsonObject *object = aJson.getObjectItem(msg, group);
+  aJsonObject *item = object ? aJson.getObjectItem(object, key) : NULL;
+  return item ? item->valueint : -1;
+}
+
+static void testOneByteAtATime()
+{
+  TestStream serial;
+  aJsonFrameStream stream(&serial, frame, sizeof(frame));
+
+  //junk and newlines before, brackets and quotes inside a string
+  CHECK(feedBytes(serial, stream, "\r\n{\"AT\":{\"K1\":\"w\",\"S\":\"a}]\\\"b{\",\"V1\":200}}") == 1);
+  aJsonObject *msg = aJson.parse(&stream);
+  CHECK(msg != NULL);
+  CHECK(itemInt(msg, "AT", "V1") == 200);
+  aJsonObject *text = aJson.getObjectItem(aJson.getObjectItem(msg, "AT"), "S");
+  CHECK(text && !strcmp(text->valuestring, "a}]\"b{"));
+  aJson.deleteItem(msg);
+
+  CHECK(feedBytes(serial, stream, " junk [1,2,{\"x\":[3]}]") == 1);
+  msg = aJson.parse(&stream);
+  CHECK(msg != NULL && aJson.getArraySize(msg) == 3);
+  aJson.deleteItem(msg);
+  CHECK(!stream.available());
+}
+
+static void testSplitAcrossCalls()
+{
+  TestStream serial;
+  aJsonFrameStream stream(&serial, frame, sizeof(frame));
+
+  serial.feed("{\"CF\":{\"ME\":");
+  CHECK(!stream.available());
+  CHECK(stream.length() == 0);
+  serial.feed("4,\"HP\":100}}{\"CF\"");
+  CHECK(stream.available()); //the next frame starts in the same packet
+  CHECK(stream.length() == strlen("{\"CF\":{\"ME\":4,\"HP\":100}}"));
+  aJsonObject *msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "CF", "ME") == 4);
+  CHECK(itemInt(msg, "CF", "HP") == 100);
+  aJson.deleteItem(msg);
+
+  CHECK(!stream.available());
+  serial.feed(":{\"MP\":9}}");
+  CHECK(stream.available());
+  msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "CF", "MP") == 9);
+  aJson.deleteItem(msg);
+}
+
+static void testOverlongFrame()
+{
+  TestStream serial;
+  aJsonFrameStream stream(&serial, frame, sizeof(frame));
+
+  //longer than the frame buffer, dropped; the frame after it still comes
+  std::string bytes = "{\"X\":\"" + std::string(100, 'a') + "\"}{\"AT\":{\"V2\":120}}";
+  CHECK(feedBytes(serial, stream, bytes) == 1);
+  aJsonObject *msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "AT", "V2") == 120);
+  aJson.deleteItem(msg);
+
+  //all at once too
+  serial.feed(bytes);
+  CHECK(stream.available());
+  msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "AT", "V2") == 120);
+  aJson.deleteItem(msg);
+}
+
+static void testBrokenFrame()
+{
+  TestStream serial;
+  aJsonFrameStream stream(&serial, frame, sizeof(frame));
+
+  CHECK(feedBytes(serial, stream, "{\"AT\":{\"K1\":tru}}") == 1);
+  CHECK(aJson.parse(&stream) == NULL);
+  CHECK(feedBytes(serial, stream, "{\"AT\":{\"V1\":60}}") == 1);
+  aJsonObject *msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "AT", "V1") == 60);
+  aJson.deleteItem(msg);
+}
+
+static void testMessagePack()
+{
+  TestStream serial;
+  aJsonFrameStream stream(&serial, frame, sizeof(frame));
+
+  //{"AT":{"V1":200,"K1":"w"}}
+  static const char pack[] = "\x81\xA2" "AT" "\x82\xA2" "V1" "\xCC\xC8" "\xA2" "K1" "\xA1" "w";
+  std::string bytes("\n");
+  bytes.append(pack, sizeof(pack) - 1);
+  CHECK(feedBytes(serial, stream, bytes) == 1);
+  CHECK(stream.length() == sizeof(pack) - 1);
+  aJsonObject *msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "AT", "V1") == 200);
+  aJsonObject *key = aJson.getObjectItem(aJson.getObjectItem(msg, "AT"), "K1");
+  CHECK(key && !strcmp(key->valuestring, "w"));
+  aJson.deleteItem(msg);
+
+  //JSON right after MessagePack
+  CHECK(feedBytes(serial, stream, "{\"CF\":{\"ME\":5}}") == 1);
+  msg = aJson.parse(&stream);
+  CHECK(itemInt(msg, "CF", "ME") == 5);
+  aJson.deleteItem(msg);
+}
+
+int main()
+{
+  testOneByteAtATime();
+  testSplitAcrossCalls();
+  testOverlongFrame();
+  testBrokenFrame();
+  testMessagePack();
+  return testResult("test_frame_stream");
+}
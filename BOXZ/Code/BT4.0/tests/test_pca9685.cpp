@@ -0,0 +1,38 @@
+/*
+test_pca9685.cpp - Servo pulse to PCA9685 counts and back.
+
+ The conversion is done in 32 bit as on the AVR. A frame of 4096 counts is
+ 20000us at 50Hz and 4098us at 244Hz, the highest frequency begin() takes.
+ */
+
+#include "test.h"
+#include <PCA9685.h>
+
+int main()
+{
+  uint16_t scale = PCA9685::usScale(50);
+  CHECK(scale == 13422); //0.2048 counts per us
+  CHECK(PCA9685::usToCount(1500, scale) == 307);
+  CHECK(PCA9685::usToCount(544, scale) == 111);
+  CHECK(PCA9685::usToCount(2400, scale) == 491);
+  CHECK(PCA9685::countToUs(307, scale) == 1498);
+  CHECK(PCA9685::countToUs(491, scale) == 2397);
+
+  scale = PCA9685::usScale(244);
+  CHECK(scale == 65498); //0.9994 counts per us
+  CHECK(PCA9685::usToCount(1500, scale) == 1499);
+  CHECK(PCA9685::usToCount(4000, scale) == 3997);
+  CHECK(PCA9685::countToUs(1499, scale) == 1499);
+  CHECK(PCA9685::countToUs(4095, scale) == 4097);
+
+  //every pulse a servo takes comes back within one count
+  for(int freq = 24; freq <= 244; freq += 22){
+    scale = PCA9685::usScale(freq);
+    for(uint16_t us = 500; us <= 2500; us += 100){
+      uint16_t back = PCA9685::countToUs(PCA9685::usToCount(us, scale), scale);
+      CHECK(back <= us && us - back <= 1000000UL / 4096 / freq + 1);
+    }
+  }
+
+  return testResult("test_pca9685");
+}
@@ -0,0 +1,66 @@
+/*
+test_strings.cpp - A string that does not fit fails the parse, it is never cut.
+
+ Heap mode holds aJson_HeapStringSize - 1 chars, an arena what is left of it.
+ The same holds for JSON and MessagePack strings and for key names.
+ */
+
+#include "test.h"
+#include <aJSON.h>
+
+static aJsonObject *parseText(const std::string &text)
+{
+  static char in[512];
+  strcpy(in, text.c_str());
+  return aJson.parse(in);
+}
+
+static std::string jsonString(size_t length)
+{
+  return "{\"ID\":\"" + std::string(length, 'x') + "\"}";
+}
+
+static std::string packString(size_t length)
+{
+  std::string pack("\x81\xA2" "ID" "\xD9", 5); //str 8 header
+  pack += (char) length;
+  return pack + std::string(length, 'x');
+}
+
+static bool parsesWhole(const std::string &text, size_t length)
+{
+  aJsonObject *msg = parseText(text);
+  if(!msg) return false;
+  aJsonObject *id = aJson.getObjectItem(msg, "ID");
+  bool whole = id && strlen(id->valuestring) == length;
+  CHECK(whole); //parsed means parsed in full
+  aJson.deleteItem(msg);
+  return true;
+}
+
+int main()
+{
+  const size_t longest = aJson_HeapStringSize - 1;
+
+  //heap
+  CHECK(parsesWhole(jsonString(longest), longest));
+  CHECK(!parsesWhole(jsonString(longest + 1), longest + 1));
+  CHECK(parsesWhole(jsonString(70), 70)); //longer than the buffers of parseEvents()
+  CHECK(parsesWhole(jsonString(0), 0));
+  CHECK(parsesWhole(packString(longest), longest));
+  CHECK(!parsesWhole(packString(longest + 1), longest + 1));
+  CHECK(parseText("{\"" + std::string(longest + 1, 'k') + "\":1}") == NULL);
+
+  //arena, longer strings fit as long as there is room
+  static char arena[400];
+  aJson.setArena(arena, sizeof(arena));
+  CHECK(parsesWhole(jsonString(200), 200));
+  aJson.resetArena();
+  CHECK(parsesWhole(packString(200), 200));
+  aJson.resetArena();
+  CHECK(!parsesWhole(jsonString(sizeof(arena)), sizeof(arena)));
+  aJson.resetArena();
+  aJson.setArena(NULL, 0);
+
+  return testResult("test_strings");
+}
@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""boxz_latency.py - round trip latency of the BOXZ app link.
+
+ Sends round trip probes (ME 256 + tag) to a BOXZ on a serial port or pty at
+ a fixed rate and reports the percentiles of the time until the answer:
+
+   python3 tools/boxz_latency.py /dev/rfcomm0 --rate 20 --count 500
+   python3 tools/boxz_latency.py /dev/ttyACM0 --binary
+
+ The answer carries micros() of the robot when the probe was received (RX),
+ when motorCom() ran after it (MO) and when the answer was sent (TX), see
+ sendEcho() of the ROMEO BLE example. The round trip is split into
+
+   robot = TX - RX, of that queue = MO - RX and reply = TX - MO
+   link  = round trip - robot, both directions together
+
+ The robot clock is only used for differences, it does not need to match
+ this one. With --binary the tool asks for BFrames (ME 5) first and probes
+ with BFRAME_COMMAND frames, else it sends JSON lines.
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+"""
+
+import argparse
+import json
+import math
+import os
+import select
+import sys
+import termios
+import time
+
+ME_ECHO = 0x100  # ME of a probe is ME_ECHO + tag
+ME_BINARY = 5    # switch the link to BFrames
+
+# BFrame.h
+FRAME_SYNC = 0xB5
+FRAME_PAYLOAD = 15
+FRAME_COMMAND = ord('C')
+FRAME_ECHO = ord('E')
+CF_ME = 0x01     # fields bit of ME, BoxzCommand.h
+
+BAUDS = {9600: termios.B9600, 19200: termios.B19200, 38400: termios.B38400,
+         57600: termios.B57600, 115200: termios.B115200}
+
+
+def crc8(data):
+    """CRC-8 polynomial 0x07, _crc8_ccitt_update() of avr-libc."""
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def frame(type_, seq, payload):
+    body = bytes([len(payload), type_, seq & 0xFF]) + bytes(payload)
+    return bytes([FRAME_SYNC]) + body + bytes([crc8(body)])
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+    if os.isatty(fd):
+        attr = termios.tcgetattr(fd)
+        attr[0] = 0                                  # iflag
+        attr[1] = 0                                  # oflag
+        attr[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attr[3] = 0                                  # lflag, raw
+        attr[4] = attr[5] = BAUDS[baud]
+        attr[6][termios.VMIN] = 0
+        attr[6][termios.VTIME] = 0
+        termios.tcsetattr(fd, termios.TCSANOW, attr)
+        termios.tcflush(fd, termios.TCIOFLUSH)
+    return fd
+
+
+class Link:
+    """Writes probes and collects the echo answers of one port."""
+
+    def __init__(self, fd, binary):
+        self.fd = fd
+        self.binary = binary
+        self.seq = 0
+        self.raw = b''
+
+    def command(self, me):
+        if self.binary:
+            data = frame(FRAME_COMMAND, self.seq, [CF_ME, me & 0xFF, me >> 8])
+            self.seq += 1
+        else:
+            data = ('{"CF":{"ME":%d}}\n' % me).encode()
+        os.write(self.fd, data)
+
+    def read(self, timeout):
+        """Answers received within timeout, (tag, rx, mo, tx) each."""
+        ready, _, _ = select.select([self.fd], [], [], max(timeout, 0))
+        if ready:
+            try:
+                self.raw += os.read(self.fd, 4096)
+            except OSError:  # pty without the other side
+                pass
+        return self.frames() if self.binary else self.lines()
+
+    def lines(self):
+        answers = []
+        while b'\n' in self.raw:
+            line, self.raw = self.raw.split(b'\n', 1)
+            if b'"EC"' not in line:
+                continue  # telemetry
+            try:
+                echo = json.loads(line.decode('ascii', 'replace'))['EC']
+                answers.append((echo['ID'], echo['RX'], echo['MO'], echo['TX']))
+            except (ValueError, KeyError, TypeError):
+                pass
+        return answers
+
+    def frames(self):
+        answers = []
+        while True:
+            start = self.raw.find(bytes([FRAME_SYNC]))
+            if start < 0:
+                self.raw = b''
+                break
+            self.raw = self.raw[start:]
+            if len(self.raw) < 2:
+                break
+            size = self.raw[1]
+            if size > FRAME_PAYLOAD:
+                self.raw = self.raw[1:]  # not a frame, rescan after the sync byte
+                continue
+            if len(self.raw) < size + 5:
+                break
+            body = self.raw[1:size + 4]
+            if crc8(body) != self.raw[size + 4]:
+                self.raw = self.raw[1:]
+                continue
+            self.raw = self.raw[size + 5:]
+            payload = body[3:]
+            if body[1] == FRAME_ECHO and len(payload) == 13:
+                stamps = [int.from_bytes(payload[1 + 4 * i:5 + 4 * i], 'little')
+                          for i in range(3)]
+                answers.append((payload[0],) + tuple(stamps))
+        return answers
+
+
+def percentile(values, p):
+    """Nearest rank percentile of sorted values."""
+    if not values:
+        return float('nan')
+    rank = max(0, min(len(values) - 1, int(math.ceil(p / 100.0 * len(values))) - 1))
+    return values[rank]
+
+
+def ticks(later, earlier):
+    """micros() difference of the robot in ms, its clock wraps at 32 bit."""
+    return ((later - earlier) & 0xFFFFFFFF) / 1000.0
+
+
+def run(args):
+    fd = open_port(args.port, args.baud)
+    link = Link(fd, False)
+    if args.binary:
+        link.command(ME_BINARY)
+        time.sleep(0.2)
+        link.binary = True
+    link.raw = b''
+
+    sent = {}  # tag: time of the probe
+    results = {'round trip': [], 'link': [], 'robot': [], '  queue': [], '  reply': []}
+    period = 1.0 / args.rate
+    next_send = time.monotonic()
+    probes = 0
+    lost = 0
+    while probes < args.count or sent:
+        now = time.monotonic()
+        if probes < args.count and now >= next_send:
+            tag = probes & 0xFF
+            if tag in sent:
+                lost += 1  # tag used again, its answer is late beyond any timeout
+            sent[tag] = now
+            link.command(ME_ECHO + tag)
+            probes += 1
+            next_send += period
+        for tag in [t for t, at in sent.items() if now - at > args.timeout]:
+            del sent[tag]
+            lost += 1
+        wait = next_send - time.monotonic() if probes < args.count else args.timeout
+        for tag, rx, mo, tx in link.read(min(wait, 0.05)):
+            if tag not in sent:
+                continue  # answer after its timeout
+            round_trip = (time.monotonic() - sent.pop(tag)) * 1000.0
+            robot = ticks(tx, rx)
+            results['round trip'].append(round_trip)
+            results['link'].append(round_trip - robot)
+            results['robot'].append(robot)
+            results['  queue'].append(ticks(mo, rx))
+            results['  reply'].append(ticks(tx, mo))
+    os.close(fd)
+
+    answered = len(results['round trip'])
+    print('probes %d  answered %d  lost %d' % (probes, answered, lost))
+    print('%-12s %8s %8s %8s   (ms)' % ('', 'p50', 'p95', 'p99'))
+    for name in ('round trip', 'link', 'robot', '  queue', '  reply'):
+        values = sorted(results[name])
+        print('%-12s %8.2f %8.2f %8.2f' % ((name,) + tuple(
+            percentile(values, p) for p in (50, 95, 99))))
+    return 0 if answered else 1
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Round trip latency of the BOXZ app link.')
+    parser.add_argument('port', help='serial port or pty, e.g. /dev/rfcomm0')
+    parser.add_argument('--baud', type=int, default=115200, choices=sorted(BAUDS))
+    parser.add_argument('--rate', type=float, default=20.0, help='probes per second')
+    parser.add_argument('--count', type=int, default=200, help='probes to send')
+    parser.add_argument('--timeout', type=float, default=1.0,
+                        help='seconds before a probe counts as lost')
+    parser.add_argument('--binary', action='store_true',
+                        help='probe with BFrames instead of JSON')
+    args = parser.parse_args()
+    if args.rate <= 0 or args.count <= 0:
+        parser.error('rate and count must be positive')
+    sys.exit(run(args))
+
+
+if __name__ == '__main__':
+    main()
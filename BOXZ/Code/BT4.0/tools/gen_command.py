@@ -0,0 +1,602 @@
+#!/usr/bin/env python3
+"""gen_command.py - generate the BOXZ command decoder.
+
+ Reads the command schema (boxz_command.txt) and writes BoxzCommand.h and
+ BoxzCommand.cpp into lib/BOXZ. Run it again after changing the schema:
+
+   python3 tools/gen_command.py
+
+ The decoder reads one JSON or MessagePack frame straight into the fields of
+ struct BoxzCommand, no objects are built. The payload of a binary frame
+ (BFrame.h) is the fields bits followed by the values of those fields in
+ schema order, ints little endian. Keys are found by a minimal
+ perfect hash over their two chars, searched here.
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+"""
+
+import os
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+SCHEMA = os.path.join(HERE, 'boxz_command.txt')
+KEYS = 0  # slots of the hash, one per key
+OUTPUT = os.path.join(HERE, '..', 'lib', 'BOXZ')
+
+TYPES = {
+    'int': ('int16_t', -32768, 32767),
+    'byte': ('uint8_t', 0, 255),
+    'char': ('char', 0, 255),
+}
+
+
+def fail(line_no, message):
+    sys.exit('%s:%d: %s' % (SCHEMA, line_no, message))
+
+
+def read_schema(path):
+    fields = []
+    for line_no, line in enumerate(open(path), 1):
+        comment = ''
+        if '#' in line:
+            line, comment = line.split('#', 1)
+        words = line.split()
+        if not words:
+            continue
+        if len(words) != 6:
+            fail(line_no, 'expected: object key type member min max')
+        group, key, type_, member, low, high = words
+        if len(group) != 2 or len(key) != 2:
+            fail(line_no, 'keys have two chars')
+        if type_ not in TYPES:
+            fail(line_no, 'unknown type ' + type_)
+        low, high = int(low), int(high)
+        if low < TYPES[type_][1] or high > TYPES[type_][2] or low > high:
+            fail(line_no, 'range does not fit ' + type_)
+        fields.append({'group': group.upper(), 'key': key.upper(),
+                       'type': type_, 'member': member, 'min': low,
+                       'max': high, 'comment': comment.strip()})
+    if not fields:
+        sys.exit(SCHEMA + ': no fields')
+    return fields
+
+
+def key_hash(key, a, b):
+    """Slot of key, the same 8 bit math as KEY_HASH() in the decoder."""
+    return (((ord(key[0]) | 0x20) * a ^ (ord(key[1]) | 0x20) * b) & 0xFF) \
+        % KEYS
+
+
+def perfect_hash(keys):
+    """Multipliers so that every key gets its own slot of len(keys)."""
+    global KEYS
+    KEYS = len(keys)
+    for a in range(1, 256):
+        for b in range(1, 256):
+            if len(set(key_hash(k, a, b) for k in keys)) == KEYS:
+                return a, b
+    sys.exit('no perfect hash found for ' + ' '.join(keys))
+
+
+def bits_type(count):
+    if count <= 8:
+        return 'uint8_t', 2
+    if count <= 16:
+        return 'uint16_t', 4
+    return 'uint32_t', 8
+
+
+def generate(fields):
+    groups = []
+    for f in fields:
+        if f['group'] not in groups:
+            groups.append(f['group'])
+    keys = []
+    for k in groups + [f['key'] for f in fields]:
+        if k.upper() not in keys:
+            keys.append(k.upper())
+    a, b = perfect_hash(keys)
+    slot = dict((k, key_hash(k, a, b)) for k in keys)
+    table = sorted(keys, key=lambda k: slot[k])
+    group_type, group_digits = bits_type(len(groups))
+    field_type, field_digits = bits_type(len(fields))
+
+    h = []
+    h.append(HEADER % {'name': 'BoxzCommand.h'})
+    h.append('#ifndef __BOXZ_COMMAND_H__\n#define __BOXZ_COMMAND_H__\n')
+    h.append('#if defined(ARDUINO) && ARDUINO >= 100\n#include <Arduino.h>\n'
+             '#else\n#include <WProgram.h>\n#endif\n')
+    h.append('//objects, bits of BoxzCommand.groups')
+    for i, g in enumerate(groups):
+        h.append('#define BOXZ_%s\t\t0x%0*X' % (g, group_digits, 1 << i))
+    h.append('\n//fields, bits of BoxzCommand.fields')
+    for i, f in enumerate(fields):
+        h.append('#define BOXZ_%s_%s\t0x%0*X' % (f['group'], f['key'],
+                                               field_digits, 1 << i))
+    h.append('')
+    h.append('struct BoxzCommand\n{')
+    h.append('  %s groups; //objects in the frame' % group_type)
+    h.append('  %s fields; //fields in the frame and in range, the others '
+             'are not set' % field_type)
+    order = sorted(fields, key=lambda f: -int(TYPES[f['type']][0] == 'int16_t'))
+    for f in order:
+        rng = '' if (f['min'], f['max']) == TYPES[f['type']][1:] else \
+            ' %d-%d' % (f['min'], f['max'])
+        h.append('  %s %s; //%s.%s%s%s' % (
+            TYPES[f['type']][0], f['member'], f['group'], f['key'], rng,
+            ', ' + f['comment'] if f['comment'] else ''))
+    h.append('')
+    h.append('  //decode a JSON or MessagePack frame, false if it is malformed')
+    h.append('  //(no groups or fields are set then)')
+    h.append('  boolean parse(const char *frame, size_t len);')
+    h.append('  //decode the payload of a BFRAME_COMMAND frame: fields bits, '
+             'then their values')
+    h.append('  //in the order of the bits, ints little endian')
+    h.append('  boolean parseBinary(const uint8_t *payload, size_t len);')
+    h.append('  //take the fields of the objects in mask from a newer command, '
+             'e.g. to keep')
+    h.append('  //only the latest action of several frames')
+    h.append('  void merge(const BoxzCommand &newer, %s mask);' % group_type)
+    h.append('};\n')
+    h.append('#endif')
+
+    c = []
+    c.append(HEADER % {'name': 'BoxzCommand.cpp'})
+    c.append('#include "BoxzCommand.h"')
+    c.append('#include <avr/pgmspace.h>\n')
+    c.append('//keys by slot, a minimal perfect hash of the two chars in 8 bit')
+    c.append('#define KEY_SLOTS\t%d' % len(keys))
+    c.append('#define KEY_HASH(c0, c1)\t((uint8_t) ((unsigned int) ((c0) | 0x20) * %d '
+             '^ (unsigned int) ((c1) | 0x20) * %d) %% KEY_SLOTS)' % (a, b))
+    for k in table:
+        c.append('#define KEY_%s\t%d' % (k, slot[k]))
+    c.append('')
+    c.append('static const char keys[KEY_SLOTS][2] PROGMEM = {')
+    c.append('  ' + ', '.join("{'%s', '%s'}" % (k[0], k[1]) for k in table))
+    c.append('};\n')
+    c.append(WALKER)
+    c.append('typedef %s groups_t;\n' % group_type)
+    c.append('//object key to its bit in BoxzCommand.groups, 0 for other keys')
+    c.append('static groups_t groupBit(uint8_t key)\n{\n  switch(key){')
+    for g in groups:
+        c.append('  case KEY_%s: return BOXZ_%s;' % (g, g))
+    c.append('  default: return 0;\n  }\n}\n')
+    c.append('static void store(BoxzCommand *cmd, groups_t group, uint8_t key, '
+             'const value_t *v)\n{')
+    c.append('  switch(group){')
+    for g in groups:
+        c.append('  case BOXZ_%s:' % g)
+        c.append('    switch(key){')
+        for f in fields:
+            if f['group'] != g:
+                continue
+            if f['type'] == 'char':
+                cond = 'v->type == VALUE_STRING'
+                val = 'v->first'
+                low, high = '(uint8_t) v->first', '(uint8_t) v->first'
+            else:
+                cond = 'v->type == VALUE_NUMBER'
+                val = 'v->number'
+                low, high = 'v->number', 'v->number'
+            checks = [cond]
+            if f['min'] > TYPES[f['type']][1] or f['type'] != 'char':
+                checks.append('%s >= %d' % (low, f['min']))
+            if f['max'] < TYPES[f['type']][2] or f['type'] != 'char':
+                checks.append('%s <= %d' % (high, f['max']))
+            c.append('    case KEY_%s:' % f['key'])
+            c.append('      if(%s){' % ' && '.join(checks))
+            c.append('        cmd->%s = %s;' % (f['member'], val))
+            c.append('        cmd->fields |= BOXZ_%s_%s;' % (g, f['key']))
+            c.append('      }')
+            c.append('      break;')
+        c.append('    }')
+        c.append('    break;')
+    c.append('  }\n}\n')
+    c.append('//values of the fields bits, in the order of the bits')
+    c.append('static boolean parseFields(BoxzCommand *cmd, %s bits, cursor_t *c)'
+             % field_type)
+    c.append('{\n  value_t v;')
+    for f in fields:
+        bit = 'BOXZ_%s_%s' % (f['group'], f['key'])
+        c.append('  if(bits & %s){' % bit)
+        if f['type'] == 'int':
+            c.append('    if(c->end - c->p < 2) return false;')
+            c.append('    v.type = VALUE_NUMBER;')
+            c.append('    v.number = (int16_t) (c->p[0] | c->p[1] << 8);')
+            c.append('    c->p += 2;')
+        else:
+            c.append('    if(c->p >= c->end) return false;')
+            if f['type'] == 'char':
+                c.append('    v.type = VALUE_STRING;')
+                c.append('    v.first = *c->p++;')
+            else:
+                c.append('    v.type = VALUE_NUMBER;')
+                c.append('    v.number = *c->p++;')
+        c.append('    cmd->groups |= BOXZ_%s;' % f['group'])
+        c.append('    store(cmd, BOXZ_%s, KEY_%s, &v);' % (f['group'], f['key']))
+        c.append('  }')
+    c.append('  return c->p == c->end;\n}\n')
+    c.append('void BoxzCommand::merge(const BoxzCommand &newer, groups_t mask)\n{')
+    c.append('  groups |= newer.groups & mask;')
+    for g in groups:
+        bits = ['BOXZ_%s_%s' % (g, f['key']) for f in fields if f['group'] == g]
+        c.append('  if(mask & BOXZ_%s){' % g)
+        for f in fields:
+            if f['group'] == g:
+                c.append('    if(newer.fields & BOXZ_%s_%s) %s = newer.%s;'
+                         % (g, f['key'], f['member'], f['member']))
+        c.append('    fields |= newer.fields & (%s);' % ' | '.join(bits))
+        c.append('  }')
+    c.append('}\n')
+    c.append(PARSE)
+
+    return '\n'.join(h) + '\n', '\n'.join(c) + '\n'
+
+
+HEADER = '''/*
+%(name)s - Decoder of BOXZ app commands.
+ Created for BOXZ, https://github.com/leolite/BOXZ
+
+ License: Attribution-NonCommercial-ShareAlike 3.0 Unported (CC BY-NC-SA 3.0)
+ http://creativecommons.org/licenses/by-nc-sa/3.0/
+
+ Generated by tools/gen_command.py from tools/boxz_command.txt, do not edit.
+ */
+'''
+
+WALKER = r'''#define KEY_NONE	0xFF
+#define PACK_DEPTH	4  //nesting of skipped MessagePack values
+
+//a value as far as the fields need it
+#define VALUE_OTHER	0
+#define VALUE_NUMBER	1
+#define VALUE_STRING	2
+
+typedef struct {
+  uint8_t type;
+  long number;  //VALUE_NUMBER, fraction cut off
+  char first;   //VALUE_STRING, first char or 0
+} value_t;
+
+typedef struct {
+  const uint8_t *p;
+  const uint8_t *end;
+} cursor_t;
+
+static uint8_t keyLookup(uint8_t c0, uint8_t c1)
+{
+  uint8_t slot = KEY_HASH(c0, c1);
+  if((pgm_read_byte(&keys[slot][0]) | 0x20) != (c0 | 0x20)) return KEY_NONE;
+  if((pgm_read_byte(&keys[slot][1]) | 0x20) != (c1 | 0x20)) return KEY_NONE;
+  return slot;
+}
+
+/************ JSON ***********************/
+
+static int jsonPeek(cursor_t *c)
+{
+  while(c->p < c->end && *c->p <= ' ') c->p++;
+  return c->p < c->end ? *c->p : -1;
+}
+
+static boolean jsonExpect(cursor_t *c, uint8_t ch)
+{
+  if(jsonPeek(c) != ch) return false;
+  c->p++;
+  return true;
+}
+
+//string at c->p, first char into *first, returns its length or -1
+static int jsonString(cursor_t *c, uint8_t *first, uint8_t *second)
+{
+  if(!jsonExpect(c, '"')) return -1;
+  int len = 0;
+  while(c->p < c->end && *c->p != '"'){
+    uint8_t ch = *c->p++;
+    if(ch == '\\'){
+      if(c->p >= c->end) return -1;
+      ch = *c->p++; //escaped char as it is, \u is not needed here
+    }
+    if(len == 0) *first = ch;
+    if(len == 1) *second = ch;
+    len++;
+  }
+  if(c->p >= c->end) return -1;
+  c->p++;
+  return len;
+}
+
+//key and ':', returns KEY_NONE for keys not in the schema, -1 if malformed
+static int jsonKey(cursor_t *c)
+{
+  uint8_t c0 = 0, c1 = 0;
+  int len = jsonString(c, &c0, &c1);
+  if(len < 0 || !jsonExpect(c, ':')) return -1;
+  return len == 2 ? keyLookup(c0, c1) : KEY_NONE;
+}
+
+//number, string or literal; objects and arrays are read over
+static boolean jsonValue(cursor_t *c, value_t *v)
+{
+  v->type = VALUE_OTHER;
+  int ch = jsonPeek(c);
+  if(ch == '"'){
+    uint8_t first = 0, second;
+    if(jsonString(c, &first, &second) < 0) return false;
+    v->type = VALUE_STRING;
+    v->first = first;
+    return true;
+  }
+  if(ch == '-' || (ch >= '0' && ch <= '9')){
+    boolean negative = ch == '-';
+    if(negative) c->p++;
+    long n = 0;
+    while(c->p < c->end && *c->p >= '0' && *c->p <= '9'){
+      if(n < 100000L) n = n * 10 + (*c->p - '0'); //anything larger is out of range anyway
+      c->p++;
+    }
+    //fraction and exponent are cut off
+    while(c->p < c->end && (*c->p == '.' || *c->p == 'e' || *c->p == 'E'
+        || *c->p == '+' || *c->p == '-' || (*c->p >= '0' && *c->p <= '9'))) c->p++;
+    v->type = VALUE_NUMBER;
+    v->number = negative ? -n : n;
+    return true;
+  }
+  uint8_t depth = 0;
+  while(c->p < c->end){
+    ch = *c->p;
+    if(ch == '"'){
+      uint8_t first, second;
+      if(jsonString(c, &first, &second) < 0) return false;
+      if(depth == 0) return true;
+      continue;
+    }
+    if(ch == '{' || ch == '[') depth++;
+    else if(ch == '}' || ch == ']'){
+      if(depth == 0) return true; //end of the enclosing object
+      if(--depth == 0){
+        c->p++;
+        return true;
+      }
+    }
+    else if(ch == ',' && depth == 0) return true;
+    c->p++;
+  }
+  return false;
+}
+
+/************ MessagePack ***********************/
+
+//big endian number of bytes
+static boolean packNumber(cursor_t *c, uint8_t bytes, uint32_t *value)
+{
+  if(c->end - c->p < bytes) return false;
+  *value = 0;
+  while(bytes--) *value = *value << 8 | *c->p++;
+  return true;
+}
+
+static boolean packSkip(cursor_t *c, uint32_t bytes)
+{
+  if((uint32_t) (c->end - c->p) < bytes) return false;
+  c->p += bytes;
+  return true;
+}
+
+//length of a string at c->p, -1 if it is no string
+static long packString(cursor_t *c)
+{
+  if(c->p >= c->end) return -1;
+  uint8_t type = *c->p;
+  uint32_t len;
+  if(type >= 0xa0 && type <= 0xbf){
+    c->p++;
+    return type & 0x1f;
+  }
+  if(type < 0xd9 || type > 0xdb) return -1;
+  c->p++;
+  if(!packNumber(c, 1 << (type - 0xd9), &len)){
+    c->p = c->end; //cut off, nothing more to read
+    return -1;
+  }
+  return len;
+}
+
+//entries of a map or array at c->p, -1 if it is neither
+static long packCount(cursor_t *c, boolean map)
+{
+  if(c->p >= c->end) return -1;
+  uint8_t type = *c->p;
+  uint32_t count;
+  if((type & 0xf0) == (map ? 0x80 : 0x90)){
+    c->p++;
+    return type & 0x0f;
+  }
+  uint8_t first = map ? 0xde : 0xdc;
+  if(type != first && type != first + 1) return -1;
+  c->p++;
+  if(!packNumber(c, type == first ? 2 : 4, &count)){
+    c->p = c->end; //cut off, nothing more to read
+    return -1;
+  }
+  return count;
+}
+
+static boolean packValue(cursor_t *c, value_t *v, uint8_t depth)
+{
+  v->type = VALUE_OTHER;
+  if(c->p >= c->end) return false;
+  long len = packString(c);
+  if(len >= 0){
+    if(c->end - c->p < len) return false;
+    v->type = VALUE_STRING;
+    v->first = len ? *c->p : 0;
+    c->p += len;
+    return true;
+  }
+  for(uint8_t map = 0; map < 2; map++){
+    long count = packCount(c, map);
+    if(count < 0) continue;
+    if(depth >= PACK_DEPTH) return false;
+    value_t skipped;
+    for(count *= map + 1; count > 0; count--){
+      if(!packValue(c, &skipped, depth + 1)) return false;
+    }
+    return true;
+  }
+  if(c->p >= c->end) return false; //a string or map header was cut off
+  uint8_t type = *c->p++;
+  uint32_t u;
+  if(type <= 0x7f || type >= 0xe0){
+    v->type = VALUE_NUMBER;
+    v->number = (int8_t) type;
+    return true;
+  }
+  switch(type){
+  case 0xcc: case 0xcd: case 0xce: //uint 8, 16, 32
+    if(!packNumber(c, 1 << (type - 0xcc), &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = u > 100000UL ? 100000L : (long) u; //out of range anyway
+    return true;
+  case 0xd0: //int 8
+    if(!packNumber(c, 1, &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = (int8_t) u;
+    return true;
+  case 0xd1: //int 16
+    if(!packNumber(c, 2, &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = (int16_t) u;
+    return true;
+  case 0xd2: //int 32
+    if(!packNumber(c, 4, &u)) return false;
+    v->type = VALUE_NUMBER;
+    v->number = (int32_t) u;
+    return true;
+  case 0xc0: case 0xc2: case 0xc3: //nil, false, true
+    return true;
+  case 0xca: return packSkip(c, 4); //float 32
+  case 0xcb: case 0xcf: case 0xd3: return packSkip(c, 8); //float 64, 64 bit ints
+  case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8: //fixext
+    return packSkip(c, 1 + (1 << (type - 0xd4)));
+  case 0xc4: case 0xc5: case 0xc6: //bin
+    return packNumber(c, 1 << (type - 0xc4), &u) && packSkip(c, u);
+  case 0xc7: case 0xc8: case 0xc9: //ext
+    return packNumber(c, 1 << (type - 0xc7), &u) && packSkip(c, u + 1);
+  default:
+    return false;
+  }
+}
+
+//key at c->p, returns KEY_NONE for keys not in the schema, -1 if malformed
+static int packKey(cursor_t *c)
+{
+  long len = packString(c);
+  if(len < 0 || c->end - c->p < len) return -1;
+  const uint8_t *key = c->p;
+  c->p += len;
+  return len == 2 ? keyLookup(key[0], key[1]) : KEY_NONE;
+}
+
+/************ generated from the schema ***********************/
+'''
+
+PARSE = r'''/************ end of generated code ***********************/
+
+static boolean parseJson(BoxzCommand *cmd, cursor_t *c)
+{
+  value_t v;
+  if(!jsonExpect(c, '{')) return false;
+  if(jsonExpect(c, '}')) return true;
+  do{
+    int key = jsonKey(c);
+    if(key < 0) return false;
+    groups_t group = key == KEY_NONE ? 0 : groupBit(key);
+    if(group && jsonPeek(c) == '{'){
+      cmd->groups |= group;
+      c->p++;
+      if(!jsonExpect(c, '}')){
+        do{
+          int field = jsonKey(c);
+          if(field < 0 || !jsonValue(c, &v)) return false;
+          if(field != KEY_NONE) store(cmd, group, field, &v);
+        }while(jsonExpect(c, ','));
+        if(!jsonExpect(c, '}')) return false;
+      }
+    }
+    else if(!jsonValue(c, &v)) return false;
+  }while(jsonExpect(c, ','));
+  return jsonExpect(c, '}');
+}
+
+static boolean parsePack(BoxzCommand *cmd, cursor_t *c)
+{
+  value_t v;
+  long count = packCount(c, true);
+  if(count < 0) return false;
+  for(; count > 0; count--){
+    int key = packKey(c);
+    if(key < 0) return false;
+    groups_t group = key == KEY_NONE ? 0 : groupBit(key);
+    long fields = group ? packCount(c, true) : -1;
+    if(fields >= 0){
+      cmd->groups |= group;
+      for(; fields > 0; fields--){
+        int field = packKey(c);
+        if(field < 0 || !packValue(c, &v, 1)) return false;
+        if(field != KEY_NONE) store(cmd, group, field, &v);
+      }
+    }
+    else if(!packValue(c, &v, 1)) return false;
+  }
+  return true;
+}
+
+boolean BoxzCommand::parse(const char *frame, size_t len)
+{
+  cursor_t c;
+  c.p = (const uint8_t *) frame;
+  c.end = c.p + len;
+  groups = 0;
+  fields = 0;
+  while(c.p < c.end && *c.p <= ' ') c.p++;
+  if(c.p >= c.end) return false;
+  //a MessagePack map starts with a byte of 0x80 or more, JSON never does
+  if(*c.p >= 0x80 ? parsePack(this, &c) : parseJson(this, &c)) return true;
+  groups = 0; //nothing of a broken frame is used
+  fields = 0;
+  return false;
+}
+
+boolean BoxzCommand::parseBinary(const uint8_t *payload, size_t len)
+{
+  cursor_t c;
+  c.p = payload;
+  c.end = payload + len;
+  groups = 0;
+  fields = 0;
+  uint32_t bits = 0;
+  for(uint8_t i = 0; i < sizeof(fields); i++){ //little endian like the values
+    if(c.p >= c.end) return false;
+    bits |= (uint32_t) *c.p++ << (8 * i);
+  }
+  if(parseFields(this, bits, &c)) return true;
+  groups = 0;
+  fields = 0;
+  return false;
+}
+'''
+
+
+def main():
+    header, source = generate(read_schema(SCHEMA))
+    for name, text in (('BoxzCommand.h', header), ('BoxzCommand.cpp', source)):
+        path = os.path.normpath(os.path.join(OUTPUT, name))
+        with open(path, 'w') as f:
+            f.write(text)
+        print('wrote ' + path)
+
+
+if __name__ == '__main__':
+    main()